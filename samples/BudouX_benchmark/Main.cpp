@@ -0,0 +1,305 @@
+﻿// BudouX のベンチマーク
+//
+// budoux-benchmark [model.json|URL] [--output=result.json] [--kernel=Scalar|SSE2|AVX2]
+//
+// getScore / parseBoundaries / parse / parseView / BudouXBreakView を
+// 短い UI 文字列・段落・数 MB の文書に対して実行し、
+// 文字数/秒、1 回あたりのアロケーション回数、ピークメモリを JSON で出力する。
+// parseBoundaries は CPU が対応する全てのカーネルで計測し、実行前に全てのカーネルの結果が一致するかを調べる。
+
+#include <Siv3D.hpp> // OpenSiv3D v0.6.12
+
+import tomolatoon.BudouX;
+import tomolatoon.utility;
+
+namespace
+{
+	// アロケーションを数えるため、確保したサイズを先頭に記録しておく
+	struct AllocationCounter
+	{
+		static constexpr size_t HeaderSize = alignof(std::max_align_t);
+
+		inline static std::atomic<size_t> count = 0;
+
+		inline static std::atomic<size_t> liveBytes = 0;
+
+		inline static std::atomic<size_t> peakBytes = 0;
+
+		static void* Allocate(size_t size) {
+			auto* p = static_cast<uint8*>(std::malloc(HeaderSize + size));
+
+			if (not p)
+			{ throw std::bad_alloc{}; }
+
+			std::memcpy(p, &size, sizeof(size));
+
+			++count;
+
+			const size_t live = (liveBytes += size);
+
+			size_t peak = peakBytes;
+			while (peak < live && not peakBytes.compare_exchange_weak(peak, live)) {}
+
+			return (p + HeaderSize);
+		}
+
+		static void Deallocate(void* ptr) noexcept {
+			if (not ptr)
+			{ return; }
+
+			auto* p = (static_cast<uint8*>(ptr) - HeaderSize);
+
+			size_t size;
+			std::memcpy(&size, p, sizeof(size));
+
+			liveBytes -= size;
+
+			std::free(p);
+		}
+	};
+
+	struct Corpus
+	{
+		String name;
+
+		Array<String> texts;
+
+		size_t characters() const {
+			return texts.map([](const String& text) { return text.size(); }).sum();
+		}
+	};
+
+	Array<Corpus> MakeCorpora() {
+		const Array<String> uiStrings = {
+			U"はじめる",
+			U"つづきから",
+			U"設定を保存しました",
+			U"Press any key",
+			U"アイテムを入手した！",
+			U"BGM の音量",
+			U"本当に終了しますか？",
+			U"Lv.12 スライム",
+		};
+
+		const Array<String> paragraphs = {
+			U"Siv3D（シブスリーディー）は、音や画像、AI を使ったゲームやアプリを、"
+			U"モダンな C++ コードで楽しく簡単にプログラミングできるオープンソースのフレームワークです。",
+			U"吾輩は猫である。名前はまだ無い。どこで生れたかとんと見当がつかぬ。"
+			U"何でも薄暗いじめじめした所でニャーニャー泣いていた事だけは記憶している。",
+			U"BudouX は、機械学習モデルを用いて文を文節に分割する、軽量な改行位置の決定器です。"
+			U"It works for Japanese, Chinese and Thai text 😀 without any dictionary.",
+		};
+
+		String document;
+
+		while (document.size() < (2 * 1024 * 1024))
+		{
+			for (const auto& paragraph : paragraphs)
+			{ document += paragraph; }
+		}
+
+		return {
+			Corpus{.name = U"ui", .texts = uiStrings},
+			Corpus{.name = U"paragraph", .texts = paragraphs},
+			Corpus{.name = U"document", .texts = {document}},
+		};
+	}
+
+	struct Result
+	{
+		size_t calls = 0;
+
+		size_t characters = 0;
+
+		double seconds = 0.0;
+
+		size_t allocations = 0;
+
+		size_t peakBytes = 0;
+	};
+
+	// 最低 minSeconds 秒かけて f をコーパス全体に繰り返し適用する
+	template <class F>
+	Result Measure(const Corpus& corpus, F f, double minSeconds = 0.5) {
+		Result result;
+
+		// 計測の外で 1 度だけ数え、繰り返しの中では足すだけにする
+		const size_t characters = corpus.characters();
+
+		const size_t baseAllocations = AllocationCounter::count;
+		const size_t baseBytes       = AllocationCounter::liveBytes;
+
+		AllocationCounter::peakBytes = baseBytes;
+
+		const Stopwatch stopwatch{StartImmediately::Yes};
+
+		do
+		{
+			for (const auto& text : corpus.texts)
+			{ f(StringView{text}); }
+
+			result.calls      += corpus.texts.size();
+			result.characters += characters;
+		}
+		while (stopwatch.sF() < minSeconds);
+
+		result.seconds     = stopwatch.sF();
+		result.allocations = (AllocationCounter::count - baseAllocations);
+		result.peakBytes   = (AllocationCounter::peakBytes - baseBytes);
+
+		return result;
+	}
+
+	// 最適化で呼び出しが消えないように結果を流し込む
+	volatile size_t sink = 0;
+} // namespace
+
+void* operator new(size_t size) {
+	return AllocationCounter::Allocate(size);
+}
+
+void operator delete(void* p) noexcept {
+	AllocationCounter::Deallocate(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	AllocationCounter::Deallocate(p);
+}
+
+void Main() {
+	Console.open();
+
+	const auto args = System::GetCommandLineArgs();
+
+	const String modelPath = (2 <= args.size() && not args[1].starts_with(U"--"))
+	                           ? args[1]
+	                           : U"https://raw.githubusercontent.com/google/budoux/main/budoux/models/ja.json";
+
+	FilePath outputPath = U"budoux_benchmark.json";
+
+	Optional<tomolatoon::BudouXKernel> kernelOverride;
+
+	for (const auto& arg : args)
+	{
+		if (arg.starts_with(U"--output="))
+		{ outputPath = arg.substr(9); }
+
+		for (const auto kernel : tomolatoon::BudouXKernels::All)
+		{
+			if (arg == U"--kernel={}"_fmt(tomolatoon::BudouXKernels::Name(kernel)))
+			{ kernelOverride = kernel; }
+		}
+	}
+
+	const auto parser = tomolatoon::isURL(modelPath)
+	                      ? tomolatoon::BudouXParser::Download(modelPath)
+	                      : tomolatoon::BudouXParser::Load(modelPath);
+
+	if (not parser)
+	{
+		Console << U"failed to load model: {}"_fmt(modelPath);
+		return;
+	}
+
+	const auto corpora = MakeCorpora();
+
+	// 全てのカーネルが同じ境界を返すことを確かめてから計測する
+	for (const auto& corpus : corpora)
+	{
+		for (const auto& text : corpus.texts)
+		{
+			if (not tomolatoon::VerifyBudouXKernels(parser, text))
+			{
+				Console << U"kernel mismatch in corpus: {}"_fmt(corpus.name);
+				return;
+			}
+		}
+	}
+
+	if (kernelOverride && not tomolatoon::BudouXKernels::SetKernel(*kernelOverride))
+	{
+		Console << U"unsupported kernel: {}"_fmt(tomolatoon::BudouXKernels::Name(*kernelOverride));
+		return;
+	}
+
+	const StringView kernelName = tomolatoon::BudouXKernels::Name(tomolatoon::BudouXKernels::GetKernel());
+
+	Console << U"kernel: {}"_fmt(kernelName);
+
+	const std::pair<StringView, std::function<void(StringView)>> benchmarks[] = {
+		{U"getScore",
+		 [&](StringView text) {
+			 for (int64 i = 1; i < static_cast<int64>(text.size()); ++i)
+			 { sink = sink + parser.getScore(text, i); }
+		 }},
+		{U"parseBoundaries",
+		 [&](StringView text) { sink = sink + parser.parseBoundaries(text).size(); }},
+		{U"parse", [&](StringView text) { sink = sink + parser.parse(text).size(); }},
+		{U"parseView", [&](StringView text) { sink = sink + parser.parseView(text).size(); }},
+		{U"BudouXBreakView",
+		 [&](StringView text) {
+			 for (const auto& segment : text | tomolatoon::BudouXBreak(std::ref(parser)))
+			 { sink = sink + segment.size(); }
+		 }},
+	};
+
+	JSON json;
+	json[U"model"]  = modelPath;
+	json[U"kernel"] = kernelName;
+
+	const auto record = [&](const Corpus& corpus, StringView name, const Result& result) {
+		const double charsPerSecond = (result.characters / result.seconds);
+		const double allocsPerCall  = (static_cast<double>(result.allocations) / result.calls);
+
+		Console << U"{:<10} {:<24} {:>14.0f} chars/s {:>10.2f} allocs/call {:>12} peak bytes"_fmt(
+			corpus.name,
+			name,
+			charsPerSecond,
+			allocsPerCall,
+			result.peakBytes
+		);
+
+		JSON entry;
+		entry[U"corpus"]             = corpus.name;
+		entry[U"function"]           = name;
+		entry[U"calls"]              = result.calls;
+		entry[U"characters"]         = result.characters;
+		entry[U"seconds"]            = result.seconds;
+		entry[U"charsPerSecond"]     = charsPerSecond;
+		entry[U"allocationsPerCall"] = allocsPerCall;
+		entry[U"peakBytes"]          = result.peakBytes;
+
+		json[U"results"].push_back(entry);
+	};
+
+	for (const auto& corpus : corpora)
+	{
+		for (const auto& [name, benchmark] : benchmarks)
+		{ record(corpus, name, Measure(corpus, benchmark)); }
+
+		// カーネルごとの parseBoundaries
+		const auto kernel = tomolatoon::BudouXKernels::GetKernel();
+
+		for (const auto k : tomolatoon::BudouXKernels::All)
+		{
+			if (not tomolatoon::BudouXKernels::SetKernel(k))
+			{ continue; }
+
+			const Result result = Measure(corpus, [&](StringView text) {
+				sink = sink + parser.parseBoundaries(text).size();
+			});
+
+			record(corpus, U"parseBoundaries[{}]"_fmt(tomolatoon::BudouXKernels::Name(k)), result);
+		}
+
+		tomolatoon::BudouXKernels::SetKernel(kernel);
+	}
+
+	// TOMOLATOON_BUDOUX_INSTRUMENTATION を定義してビルドした場合は、パーサー内部の計測結果も出力する
+	if constexpr (tomolatoon::BudouXInstrumentation::Enabled)
+	{ json[U"instrumentation"] = tomolatoon::BudouXInstrumentation::ToJSON(); }
+
+	json.save(outputPath);
+
+	Console << U"saved: {}"_fmt(outputPath);
+}
@@ -0,0 +1,150 @@
+﻿// ゲームのテキストテーブルを事前に BudouX で分割し、サイドカーファイルに書き出すビルドステップ
+//
+// budoux-presegment <model.json|URL> <output.bxsc> <table.csv|table.toml|table.json>...
+//
+// テーブルに含まれる全ての文字列を分割して保存する。
+// 実行時には tomolatoon::BudouXSidecar で読み込めば、モデル無しで分割結果を取得できる。
+
+#include <Siv3D.hpp> // OpenSiv3D v0.6.12
+
+import tomolatoon.BudouX;
+import tomolatoon.BudouX.sidecar;
+import tomolatoon.utility;
+
+namespace
+{
+	void AddJSON(
+		tomolatoon::BudouXSidecarWriter& writer,
+		const tomolatoon::BudouXParser&  parser,
+		const JSON&                      json
+	) {
+		if (json.isString())
+		{ writer.add(parser, json.getString()); }
+		else if (json.isArray())
+		{
+			for (const auto& element : json.arrayView())
+			{ AddJSON(writer, parser, element); }
+		}
+		else if (json.isObject())
+		{
+			for (const auto& [key, value] : json)
+			{ AddJSON(writer, parser, value); }
+		}
+	}
+
+	void AddTOML(
+		tomolatoon::BudouXSidecarWriter& writer,
+		const tomolatoon::BudouXParser&  parser,
+		const TOMLValue&                 toml
+	) {
+		if (toml.isString())
+		{ writer.add(parser, toml.getString()); }
+		else if (toml.isArray())
+		{
+			for (const auto& element : toml.arrayView())
+			{ AddTOML(writer, parser, element); }
+		}
+		else if (toml.isTableArray())
+		{
+			for (const auto& table : toml.tableArrayView())
+			{ AddTOML(writer, parser, table); }
+		}
+		else if (toml.isTable())
+		{
+			for (const auto& member : toml.tableView())
+			{ AddTOML(writer, parser, member.value); }
+		}
+	}
+
+	bool AddTable(
+		tomolatoon::BudouXSidecarWriter& writer,
+		const tomolatoon::BudouXParser&  parser,
+		FilePathView                     path
+	) {
+		const String extension = FileSystem::Extension(path);
+
+		if (extension == U"csv")
+		{
+			const CSV csv{path};
+
+			if (not csv)
+			{ return false; }
+
+			for (size_t row = 0; row < csv.rows(); ++row)
+			{
+				for (size_t column = 0; column < csv.columns(row); ++column)
+				{ writer.add(parser, csv[row][column]); }
+			}
+
+			return true;
+		}
+		else if (extension == U"toml")
+		{
+			const TOMLReader toml{path};
+
+			if (not toml)
+			{ return false; }
+
+			AddTOML(writer, parser, toml);
+
+			return true;
+		}
+		else if (extension == U"json")
+		{
+			const JSON json = JSON::Load(path);
+
+			if (not json)
+			{ return false; }
+
+			AddJSON(writer, parser, json);
+
+			return true;
+		}
+
+		return false;
+	}
+} // namespace
+
+void Main() {
+	Console.open();
+
+	const auto args = System::GetCommandLineArgs();
+
+	if (args.size() < 4)
+	{
+		Console << U"usage: budoux-presegment <model.json|URL> <output.bxsc> <table>...";
+		return;
+	}
+
+	const FilePath modelPath  = args[1];
+	const FilePath outputPath = args[2];
+
+	const auto parser = tomolatoon::isURL(modelPath)
+	                      ? tomolatoon::BudouXParser::Download(modelPath)
+	                      : tomolatoon::BudouXParser::Load(modelPath);
+
+	if (not parser)
+	{
+		Console << U"failed to load model: {}"_fmt(modelPath);
+		return;
+	}
+
+	tomolatoon::BudouXSidecarWriter writer;
+
+	for (size_t i = 3; i < args.size(); ++i)
+	{
+		if (not AddTable(writer, parser, args[i]))
+		{
+			Console << U"failed to read table: {}"_fmt(args[i]);
+			return;
+		}
+	}
+
+	if (not writer.save(outputPath))
+	{
+		Console << U"failed to write: {}"_fmt(outputPath);
+		return;
+	}
+
+	Console << U"wrote {} strings to {}"_fmt(writer.size(), outputPath);
+}
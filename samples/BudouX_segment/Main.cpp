@@ -0,0 +1,177 @@
+﻿// 巨大なコーパスを BudouX で分割するコマンドラインツール
+//
+// budoux-segment <model.json|URL> <input.txt> <output> [--format=offsets|wbr] [--threads=N]
+//
+//   offsets: 境界のバイト位置を uint64 (little endian) の配列として書き出す
+//   wbr    : 境界に <wbr> を挿入した UTF-8 テキストを書き出す
+
+#include <Siv3D.hpp> // OpenSiv3D v0.6.12
+
+import tomolatoon.BudouX;
+import tomolatoon.BudouX.corpus;
+import tomolatoon.utility;
+
+namespace
+{
+	// 小さな書き込みをまとめ、大きな書き込みはマップされたメモリから直接書き出す
+	struct BufferedWriter
+	{
+		static constexpr size_t BufferSize = (1 << 20);
+
+		explicit BufferedWriter(FilePathView path)
+			: m_writer{path} {
+			m_buffer.reserve(BufferSize);
+		}
+
+		~BufferedWriter() {
+			flush();
+		}
+
+		explicit operator bool() const {
+			return static_cast<bool>(m_writer);
+		}
+
+		void write(const void* data, size_t size) {
+			if (BufferSize < (m_buffer.size() + size))
+			{ flush(); }
+
+			if (BufferSize <= size)
+			{
+				m_writer.write(data, size);
+				return;
+			}
+
+			const auto* bytes = static_cast<const Byte*>(data);
+			m_buffer.insert(m_buffer.end(), bytes, (bytes + size));
+		}
+
+		void flush() {
+			if (not m_buffer.isEmpty())
+			{
+				m_writer.write(m_buffer.data(), m_buffer.size());
+				m_buffer.clear();
+			}
+		}
+
+	private:
+
+		BinaryWriter m_writer;
+
+		Array<Byte> m_buffer;
+	};
+
+	Optional<String> GetOption(const Array<String>& args, StringView name) {
+		for (const auto& arg : args)
+		{
+			if (arg.starts_with(name))
+			{ return arg.substr(name.size()); }
+		}
+
+		return none;
+	}
+} // namespace
+
+void Main() {
+	Console.open();
+
+	const auto args = System::GetCommandLineArgs();
+
+	if (args.size() < 4)
+	{
+		Console << U"usage: budoux-segment <model.json|URL> <input.txt> <output> "
+		           U"[--format=offsets|wbr] [--threads=N]";
+		return;
+	}
+
+	const FilePath modelPath  = args[1];
+	const FilePath inputPath  = args[2];
+	const FilePath outputPath = args[3];
+
+	const String format  = GetOption(args, U"--format=").value_or(U"offsets");
+	const size_t threads = ParseOr<size_t>(GetOption(args, U"--threads=").value_or(U"0"), 0);
+
+	if (format != U"offsets" && format != U"wbr")
+	{
+		Console << U"unknown format: {}"_fmt(format);
+		return;
+	}
+
+	const auto parser = tomolatoon::isURL(modelPath)
+	                      ? tomolatoon::BudouXParser::Download(modelPath)
+	                      : tomolatoon::BudouXParser::Load(modelPath);
+
+	if (not parser)
+	{
+		Console << U"failed to load model: {}"_fmt(modelPath);
+		return;
+	}
+
+	MemoryMappedFileView input{inputPath};
+
+	if (not input)
+	{
+		Console << U"failed to open: {}"_fmt(inputPath);
+		return;
+	}
+
+	const auto mapped = input.mapAll();
+
+	const std::string_view corpus{reinterpret_cast<const char*>(mapped.data), mapped.size};
+
+	BufferedWriter writer{outputPath};
+
+	if (not writer)
+	{
+		Console << U"failed to open: {}"_fmt(outputPath);
+		return;
+	}
+
+	constexpr std::string_view Wbr = "<wbr>";
+
+	size_t boundaryCount = 0;
+
+	// wbr で、まだ書き出していないテキストの先頭
+	size_t start = 0;
+
+	const Stopwatch stopwatch{StartImmediately::Yes};
+
+	// 解析し終わったチャンクから順に書き出すので、境界を全てメモリに溜めない
+	tomolatoon::StreamUTF8Boundaries(
+		parser,
+		corpus,
+		[&](const Array<size_t>& boundaries) {
+			boundaryCount += boundaries.size();
+
+			if (format == U"offsets")
+			{
+				for (const size_t boundary : boundaries)
+				{
+					const uint64 offset = boundary;
+					writer.write(&offset, sizeof(offset));
+				}
+			}
+			else
+			{
+				for (const size_t boundary : boundaries)
+				{
+					writer.write((corpus.data() + start), (boundary - start));
+					writer.write(Wbr.data(), Wbr.size());
+
+					start = boundary;
+				}
+			}
+		},
+		threads
+	);
+
+	if (format == U"wbr")
+	{ writer.write((corpus.data() + start), (corpus.size() - start)); }
+
+	writer.flush();
+
+	Console << U"segmented {} bytes into {} phrases in {:.3f}s"_fmt(
+		corpus.size(),
+		(boundaryCount + 1),
+		stopwatch.sF()
+	);
+}
@@ -4,6 +4,9 @@
 #include <Siv3D.hpp> // OpenSiv3D v0.6.11
 
 import tomolatoon.BudouX;
+import tomolatoon.BudouX.glyph_cache;
+import tomolatoon.BudouX.layout;
+import tomolatoon.BudouX.segmented_text;
 
 void Main() {
 	const auto parser = tomolatoon::BudouXParser::Download(
@@ -17,50 +20,51 @@ void Main() {
 		U"モダンな C++ コードで楽しく簡単にプログラミングできるオープンソースのフレームワークです。"
 	};
 
+	// 編集のたびに、変更された箇所の周辺だけを再分割する
+	tomolatoon::SegmentedText segmentedText{parser, textAreaState.text};
+
+	// 文字の送り幅はキャッシュし、テキスト・幅・フォントサイズが変わった時だけ行を組み直す
+	tomolatoon::GlyphAdvanceCache glyphCache;
+	tomolatoon::PhraseLayout      layout{glyphCache.provider(font)};
+
 	double fontSizeSlider = 0.4;
 
 	bool forceReturn = false;
 
+	bool balanced = false;
+
 	while (System::Update())
 	{
+		// テキストを比べるのは、変更があったフレームだけにする
 		if (SimpleGUI::TextArea(textAreaState, Vec2{30, 20}, SizeF{740, 100}))
-		{ textAreaState.text = textAreaState.text.removed(U'\n'); }
+		{
+			textAreaState.text = textAreaState.text.removed(U'\n');
+
+			segmentedText.update(parser, textAreaState.text);
+		}
 
 		SimpleGUI::Slider(U"Font size", fontSizeSlider, Vec2{30, 130}, 100, 200);
 		const double fontSize = (fontSizeSlider * 80 + 16);
 
 		SimpleGUI::CheckBox(forceReturn, U"境界で必ず改行する", Vec2{340, 130});
 
+		if (SimpleGUI::CheckBox(balanced, U"行の長さを揃える", Vec2{560, 130}))
+		{
+			using Wrapping = tomolatoon::PhraseLayout::Wrapping;
+
+			layout.setWrapping(balanced ? Wrapping::MinimumRaggedness : Wrapping::Greedy);
+		}
+
 		{
 			Vec2 pos{30, 180};
 
-			for (const auto& s : textAreaState.text | tomolatoon::BudouXBreak(std::ref(parser)))
+			const auto& lines =
+				layout.layout(segmentedText.text(), segmentedText.boundaries(), 740, fontSize, forceReturn);
+
+			for (const auto& line : lines)
 			{
-				const auto text     = font(s);
-				const auto advances = text.getXAdvances(fontSize);
-
-				if (pos.x != 30 && (forceReturn || ((pos.x + advances.sum()) > 770)))
-				{
-					pos.x = 30;
-					pos.y += font.height(fontSize);
-				}
-
-				double advance = 0;
-				size_t start   = 0;
-				for (size_t i = 0; i < text.clusters.size(); ++i)
-				{
-					advance += advances[i];
-					if ((pos.x + advance) > 770)
-					{
-						font(s.substr(start, (text.clusters[i].pos - start))).draw(fontSize, pos);
-						pos.x = 30;
-						pos.y += font.height(fontSize);
-						advance = advances[i];
-						start += text.clusters[i].pos;
-					}
-				}
-				font(s.substr(start)).draw(fontSize, pos);
-				pos.x += advance;
+				font(segmentedText.text().substr(line.begin, (line.end - line.begin))).draw(fontSize, pos);
+				pos.y += font.height(fontSize);
 			}
 		}
 	}
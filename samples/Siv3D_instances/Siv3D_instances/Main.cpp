@@ -6,3 +6,9 @@
 //#include "../../scene_viewport_units/Main.cpp"
 #include "../../BudouX_with_ranges/Main.cpp"
 //#include "../../asset/Main.cpp"
+//#include "../../BudouX_segment/Main.cpp"
+//#include "../../BudouX_presegment/Main.cpp"
+//#include "../../BudouX_benchmark/Main.cpp"
+//#include "../../asset_loading/Main.cpp"
+//#include "../../asset_packer/Main.cpp"
+//#include "../../asset_dependencies/Main.cpp"
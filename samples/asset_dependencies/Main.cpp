@@ -0,0 +1,50 @@
+﻿// 依存の鎖がスレッド数より深いアセットを、AssetWorkerPool のスレッドから Load で読み込む
+//
+// Load は依存先が読み込まれるまで待つ。待つ間にプールの仕事を実行しなければ、
+// プールのスレッドが全て待つ側に回り、依存先を構築するスレッドが無くなって止まる。
+
+#include <Siv3D.hpp> // OpenSiv3D v0.6.12
+
+import tomolatoon.asset;
+
+namespace
+{
+	struct Link
+	{
+		size_t depth = 0;
+	};
+
+	using LinkAsset = tomolatoon::Asset<tomolatoon::AssetTraits<Link, size_t>{}>;
+
+	// 1 つ前の輪に依存する輪を depth 個つなぐ
+	void RegisterChain(size_t depth) {
+		LinkAsset::Register(0, Link{0});
+
+		for (size_t i = 1; i < depth; ++i)
+		{ LinkAsset::Register(i, tomolatoon::AssetDependsOn{LinkAsset::Dependency(i - 1)}, Link{i}); }
+	}
+} // namespace
+
+void Main() {
+	Console.open();
+
+	tomolatoon::AssetWorkerPool pool{2};
+
+	const size_t depth = (pool.threadCount() * 8);
+
+	RegisterChain(depth);
+
+	std::promise<bool> loaded;
+	auto               future = loaded.get_future();
+
+	pool.submit([&] { loaded.set_value(LinkAsset::Load(depth - 1)); });
+
+	// 止まっていれば、プールを破棄する時にも止まるので、ここで知らせておく
+	if (future.wait_for(std::chrono::seconds{5}) != std::future_status::ready)
+	{ Console << U"deadlocked: a chain of {} on {} threads"_fmt(depth, pool.threadCount()); }
+	else
+	{ Console << U"loaded a chain of {} on {} threads: {}"_fmt(depth, pool.threadCount(), future.get()); }
+
+	while (System::Update())
+	{}
+}
@@ -0,0 +1,52 @@
+﻿// Asset をバックグラウンドで読み込む
+
+#include <Siv3D.hpp> // OpenSiv3D v0.6.12
+
+import tomolatoon.asset;
+
+using TextureAsset = tomolatoon::Asset<tomolatoon::AssetTraits<Texture>{}>;
+
+void Main() {
+	const Array<String> emojis = {U"🐈", U"🐕", U"🐇", U"🐢", U"🐧", U"🦊", U"🐼", U"🐸"};
+
+	for (const auto& emoji : emojis)
+	{ TextureAsset::Register(emoji, Emoji{emoji}, TextureDesc::Mipped); }
+
+	// 最後に表示したのが古いものから破棄し、4 枚分に収める
+	TextureAsset::SetCostFunction([](const Texture& texture) { return (texture.width() * texture.height() * 4ull); });
+	TextureAsset::SetMemoryBudget(4 * (136 * 136 * 4));
+
+	const Font font{FontMethod::MSDF, 48};
+
+	while (System::Update())
+	{
+		// 構築が終わったものを、このフレームから使えるようにする
+		TextureAsset::Poll();
+
+		if (SimpleGUI::Button(U"Load", Vec2{40, 40}))
+		{
+			for (const auto& emoji : emojis)
+			{ TextureAsset::LoadAsync(emoji); }
+		}
+
+		if (SimpleGUI::Button(U"Release", Vec2{160, 40}))
+		{ TextureAsset::ReleaseAll(); }
+
+		const size_t ready = emojis.count_if([](const String& emoji) { return TextureAsset::IsReady(emoji); });
+
+		font(U"{} / {}  {} KiB"_fmt(ready, emojis.size(), (TextureAsset::GetMemoryUsage() / 1024))).draw(24, Vec2{300, 40});
+
+		// 読み込み中もフレームは止まらない
+		Circle{Scene::Center().movedBy(0, 200), 40}.drawArc(Scene::Time() * 360_deg, 90_deg, 4, 4);
+
+		for (const auto& [i, emoji] : Indexed(emojis))
+		{
+			const Vec2 center{(100 + i * 90), 200};
+
+			if (TextureAsset::IsReady(emoji))
+			{ TextureAsset{emoji}().resized(80).drawAt(center); }
+			else if (TextureAsset::IsLoading(emoji))
+			{ Circle{center, 40}.drawFrame(2, Palette::Gray); }
+		}
+	}
+}
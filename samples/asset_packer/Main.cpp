@@ -0,0 +1,77 @@
+﻿// ディレクトリ以下のファイルを 1 つのアセットパックにまとめるビルドステップ
+//
+// asset-packer <input directory> <output.pack>
+//
+// 各ファイルは、ディレクトリからの相対パス（例: "textures/logo.png"）の AssetID で引ける。
+// 実行時には tomolatoon::AssetPack でマップし、Asset::RegisterPack か AssetPackSource で登録する。
+
+#include <Siv3D.hpp> // OpenSiv3D v0.6.12
+
+import tomolatoon.asset.id;
+import tomolatoon.asset.pack;
+
+namespace
+{
+	// 既に圧縮されている形式は、展開の手間をかけずにそのまま読めるように圧縮しない
+	tomolatoon::AssetPackCompression ChooseCompression(FilePathView path) {
+		static const Array<String> compressed = {
+			U"png", U"jpg", U"jpeg", U"webp", U"gif", U"ogg", U"mp3", U"m4a", U"opus", U"mp4", U"zip", U"zst",
+		};
+
+		return (compressed.contains(FileSystem::Extension(path)) ? tomolatoon::AssetPackCompression::None
+		                                                          : tomolatoon::AssetPackCompression::Zstd);
+	}
+} // namespace
+
+void Main() {
+	Console.open();
+
+	const auto args = System::GetCommandLineArgs();
+
+	if (args.size() < 3)
+	{
+		Console << U"usage: asset-packer <input directory> <output.pack>";
+		return;
+	}
+
+	const FilePath inputDirectory = FileSystem::FullPath(args[1]);
+	const FilePath outputPath     = args[2];
+
+	if (not FileSystem::IsDirectory(inputDirectory))
+	{
+		Console << U"not a directory: {}"_fmt(inputDirectory);
+		return;
+	}
+
+	tomolatoon::AssetPackWriter writer;
+
+	for (const auto& path : FileSystem::DirectoryContents(inputDirectory, Recursive::Yes))
+	{
+		if (not FileSystem::IsFile(path))
+		{ continue; }
+
+		const String name = FileSystem::RelativePath(path, inputDirectory);
+
+		if (not writer.addFile(tomolatoon::AssetID{name}, path, ChooseCompression(path)))
+		{
+			Console << U"failed to read: {}"_fmt(path);
+			return;
+		}
+	}
+
+	try
+	{
+		if (not writer.save(outputPath))
+		{
+			Console << U"failed to write: {}"_fmt(outputPath);
+			return;
+		}
+	}
+	catch (const Error& error)
+	{
+		Console << error;
+		return;
+	}
+
+	Console << U"wrote {} assets to {}"_fmt(writer.size(), outputPath);
+}
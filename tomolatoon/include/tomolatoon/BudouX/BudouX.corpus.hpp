@@ -0,0 +1,295 @@
+﻿#pragma once
+#include <string_view>
+#include <concepts>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <Siv3D.hpp>
+#include "BudouX.hpp"
+
+namespace tomolatoon::detail
+{
+	// UTF-8 の先頭バイトでなければ true
+	constexpr bool IsUTF8Continuation(char c) noexcept {
+		return (static_cast<uint8>(c) & 0xC0) == 0x80;
+	}
+
+	// 不正なバイト列は 1 バイトずつ U+FFFD とみなす
+	constexpr size_t DecodeUTF8(std::string_view utf8, size_t pos, char32& out) noexcept {
+		const uint8 c0 = static_cast<uint8>(utf8[pos]);
+
+		size_t length = 0;
+
+		if (c0 < 0x80)
+		{ length = 1; }
+		else if ((c0 >> 5) == 0x06)
+		{ length = 2; }
+		else if ((c0 >> 4) == 0x0E)
+		{ length = 3; }
+		else if ((c0 >> 3) == 0x1E)
+		{ length = 4; }
+
+		if (length == 0 || utf8.size() < (pos + length))
+		{
+			out = U'\uFFFD';
+			return 1;
+		}
+
+		char32 ch = (length == 1) ? c0 : (c0 & (0x7F >> length));
+
+		for (size_t i = 1; i < length; ++i)
+		{
+			if (not IsUTF8Continuation(utf8[pos + i]))
+			{
+				out = U'\uFFFD';
+				return 1;
+			}
+
+			ch = (ch << 6) | (static_cast<uint8>(utf8[pos + i]) & 0x3F);
+		}
+
+		out = ch;
+		return length;
+	}
+
+	// [first, last) の範囲にある文字について境界を判定する
+	// 前後 3 文字は文脈として読むだけで、判定は行わない
+	inline Array<size_t> ParseUTF8Chunk(
+		const BudouXParser& parser,
+		std::string_view    utf8,
+		size_t              first,
+		size_t              last
+	) {
+		size_t contextFirst = first;
+
+		for (size_t n = 0; n < 3 && 0 < contextFirst; ++n)
+		{
+			do
+			{ --contextFirst; }
+			while (0 < contextFirst && IsUTF8Continuation(utf8[contextFirst]));
+		}
+
+		String        sequence;
+		Array<size_t> positions;
+
+		size_t trailing = 0;
+
+		for (size_t pos = contextFirst; pos < utf8.size() && trailing < 3;)
+		{
+			if (last <= pos)
+			{ ++trailing; }
+
+			char32 ch;
+			positions.push_back(pos);
+			pos += DecodeUTF8(utf8, pos, ch);
+			sequence.push_back(ch);
+		}
+
+		Array<size_t> result;
+
+		for (size_t i = 0; i < sequence.size(); ++i)
+		{
+			const size_t pos = positions[i];
+
+			if (pos < first || last <= pos || pos == 0)
+			{ continue; }
+
+			if (parser.parseCharacter(sequence, static_cast<int64>(i)))
+			{ result.push_back(pos); }
+		}
+
+		return result;
+	}
+
+	// 文字の途中にかからないように、pos 以降で最初の文字の先頭
+	inline size_t AlignUTF8Boundary(std::string_view utf8, size_t pos) noexcept {
+		pos = Min(pos, utf8.size());
+
+		while (pos < utf8.size() && IsUTF8Continuation(utf8[pos]))
+		{ ++pos; }
+
+		return pos;
+	}
+} // namespace tomolatoon::detail
+
+namespace tomolatoon
+{
+	/// @brief StreamUTF8Boundaries のチャンクの既定の大きさ（バイト）
+	inline constexpr size_t DefaultUTF8ChunkSize = (256 * 1024);
+
+	/// @brief UTF-8 のテキストを複数のスレッドで分割し、境界のバイト単位の位置をチャンクごとに先頭から順に渡す
+	/// @param parser 解析に用いるパーサー
+	/// @param utf8 UTF-8 のテキスト（メモリマップしたファイルなど）
+	/// @param onChunk チャンクの境界（昇順）を受け取る関数。呼び出したスレッドで、テキストの先頭のチャンクから順に呼ぶ
+	/// @param threads 使用するスレッド数、0 の場合はハードウェアスレッド数
+	/// @param chunkSize チャンクの大きさ（バイト）。文字の途中にかかる場合は次の文字の先頭まで延ばす
+	/// @details
+	/// テキストを文字の境界で区切ったチャンクごとに並列に解析する。
+	/// チャンクの前後 3 文字を文脈として重ねて読むので、結果は全体を一度に解析した場合と一致する。
+	///
+	/// 解析し終わったチャンクは、それより前のチャンクが全て onChunk に渡されるまで保持する。
+	/// 保持するのはスレッド数の 4 倍のチャンクまでで、それを超えると解析を待つので、
+	/// テキストの大きさによらず、使うメモリはチャンクの大きさとスレッド数で決まる。
+	/// @note onChunk や解析が例外を投げたら、解析を止めてその例外を呼び出したスレッドで投げる
+	template <class F>
+	requires std::invocable<F&, const Array<size_t>&>
+	void StreamUTF8Boundaries(
+		const BudouXParser& parser,
+		std::string_view    utf8,
+		F&&                 onChunk,
+		size_t              threads   = 0,
+		size_t              chunkSize = DefaultUTF8ChunkSize
+	) {
+		if (threads == 0)
+		{ threads = Max<size_t>(std::thread::hardware_concurrency(), 1); }
+
+		chunkSize = Max<size_t>(chunkSize, 1);
+
+		const size_t chunkCount = Max<size_t>(((utf8.size() + chunkSize - 1) / chunkSize), 1);
+
+		// 解析し終わったが、まだ渡していないチャンクを持つ環状の窓
+		const size_t window = Min((threads * 4), chunkCount);
+
+		Array<Optional<Array<size_t>>> pending(window);
+
+		std::mutex              mutex;
+		std::condition_variable condition;
+
+		size_t nextChunk = 0;
+		size_t delivered = 0;
+		bool   stopping  = false;
+
+		// 解析中に投げられた最初の例外
+		std::exception_ptr error;
+
+		const auto worker = [&]() {
+			for (;;)
+			{
+				size_t chunk;
+
+				{
+					std::unique_lock lock{mutex};
+
+					if (stopping || chunkCount <= nextChunk)
+					{ return; }
+
+					chunk = nextChunk++;
+
+					// 窓に空きができるまで待つ
+					condition.wait(lock, [&] { return (stopping || chunk < (delivered + window)); });
+
+					if (stopping)
+					{ return; }
+				}
+
+				try
+				{
+					auto result = detail::ParseUTF8Chunk(
+						parser,
+						utf8,
+						detail::AlignUTF8Boundary(utf8, (chunk * chunkSize)),
+						detail::AlignUTF8Boundary(utf8, ((chunk + 1) * chunkSize))
+					);
+
+					std::lock_guard lock{mutex};
+
+					pending[chunk % window] = std::move(result);
+				}
+				catch (...)
+				{
+					// チャンクが届かないまま待ち続けないよう、止めてから呼び出したスレッドに渡す
+					{
+						std::lock_guard lock{mutex};
+
+						if (not error)
+						{ error = std::current_exception(); }
+
+						stopping = true;
+					}
+
+					condition.notify_all();
+
+					return;
+				}
+
+				condition.notify_all();
+			}
+		};
+
+		Array<AsyncTask<void>> tasks;
+
+		for (size_t i = 0; i < Min(threads, chunkCount); ++i)
+		{ tasks.push_back(Async(worker)); }
+
+		const auto stop = [&]() {
+			{
+				std::lock_guard lock{mutex};
+
+				stopping = true;
+			}
+
+			condition.notify_all();
+
+			for (auto& task : tasks)
+			{ task.wait(); }
+		};
+
+		try
+		{
+			for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+			{
+				Array<size_t> result;
+
+				{
+					std::unique_lock lock{mutex};
+
+					auto& slot = pending[chunk % window];
+
+					condition.wait(lock, [&] { return (stopping || slot.has_value()); });
+
+					// 解析が例外で止まった
+					if (stopping)
+					{ break; }
+
+					result = std::move(*slot);
+					slot.reset();
+					++delivered;
+				}
+
+				condition.notify_all();
+
+				onChunk(std::as_const(result));
+			}
+		}
+		catch (...)
+		{
+			stop();
+			throw;
+		}
+
+		stop();
+
+		if (error)
+		{ std::rethrow_exception(error); }
+	}
+
+	/// @brief UTF-8 のテキストを複数のスレッドで分割し、境界をバイト単位の位置で返す
+	/// @param parser 解析に用いるパーサー
+	/// @param utf8 UTF-8 のテキスト（メモリマップしたファイルなど）
+	/// @param threads 使用するスレッド数、0 の場合はハードウェアスレッド数
+	/// @details 全ての境界を 1 つの配列に集める。巨大なテキストでは、StreamUTF8Boundaries で順に書き出す方がよい
+	inline Array<size_t>
+		ParseUTF8Boundaries(const BudouXParser& parser, std::string_view utf8, size_t threads = 0) {
+		Array<size_t> result;
+
+		StreamUTF8Boundaries(
+			parser,
+			utf8,
+			[&](const Array<size_t>& boundaries) { result.append(boundaries); },
+			threads
+		);
+
+		return result;
+	}
+} // namespace tomolatoon
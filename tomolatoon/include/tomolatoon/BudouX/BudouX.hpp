@@ -1,14 +1,458 @@
-﻿#include <ranges>
+﻿#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <concepts>
+#include <limits>
+#include <mutex>
+#include <ranges>
+#include <tuple>
+#include <utility>
 #include <Siv3D.hpp>
 #include "rivet.hpp"
+#if defined(_M_X64) || defined(__x86_64__)
+#	define TOMOLATOON_BUDOUX_X64
+#	include <immintrin.h>
+#	ifdef _MSC_VER
+#		include <intrin.h>
+#	endif
+#endif
+
+#if defined(_MSC_VER) && not defined(__clang__)
+#	define TOMOLATOON_BUDOUX_TARGET(isa)
+#else
+#	define TOMOLATOON_BUDOUX_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+namespace tomolatoon::detail
+{
+	// scores[i] > threshold となる i のビットを立てる（count <= 64）
+	inline uint64 BudouXThresholdScalar(const int32* scores, size_t count, int32 threshold) noexcept {
+		uint64 mask = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{ mask |= (static_cast<uint64>(threshold < scores[i]) << i); }
+
+		return mask;
+	}
+
+#ifdef TOMOLATOON_BUDOUX_X64
+	TOMOLATOON_BUDOUX_TARGET("sse2")
+	inline uint64 BudouXThresholdSSE2(const int32* scores, size_t count, int32 threshold) noexcept {
+		const __m128i border = _mm_set1_epi32(threshold);
+
+		uint64 mask = 0;
+		size_t i    = 0;
+
+		for (; (i + 4) <= count; i += 4)
+		{
+			const __m128i v    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(scores + i));
+			const int32   bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(v, border)));
+
+			mask |= (static_cast<uint64>(bits) << i);
+		}
+
+		if (i < count)
+		{ mask |= (BudouXThresholdScalar((scores + i), (count - i), threshold) << i); }
+
+		return mask;
+	}
+
+	TOMOLATOON_BUDOUX_TARGET("avx2")
+	inline uint64 BudouXThresholdAVX2(const int32* scores, size_t count, int32 threshold) noexcept {
+		const __m256i border = _mm256_set1_epi32(threshold);
+
+		uint64 mask = 0;
+		size_t i    = 0;
+
+		for (; (i + 8) <= count; i += 8)
+		{
+			const __m256i v    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(scores + i));
+			const int32   bits = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(v, border)));
+
+			mask |= (static_cast<uint64>(bits) << i);
+		}
+
+		if (i < count)
+		{ mask |= (BudouXThresholdScalar((scores + i), (count - i), threshold) << i); }
+
+		return mask;
+	}
+#endif
+} // namespace tomolatoon::detail
 
 namespace tomolatoon
 {
-	struct BudouXParser
+	/// @brief BudouXParser::parseBoundaries でスコアの閾値判定に使う命令セット
+	enum class BudouXKernel : uint8
+	{
+		Scalar,
+		SSE2,
+		AVX2,
+	};
+
+	/// @brief CPU の機能を調べて、BudouXParser が使うカーネルを選ぶ
+	/// @details
+	/// 最初に使われた時に CPU が対応する中で最も速いカーネルを選ぶ。
+	/// テストやベンチマークのために SetKernel で上書きできる。
+	struct BudouXKernels
+	{
+		// scores の先頭 count 個（64 個以下）について、threshold より大きいもののビットを立てて返す
+		using ThresholdFunction = uint64 (*)(const int32* scores, size_t count, int32 threshold) noexcept;
+
+		static constexpr BudouXKernel All[] = {BudouXKernel::Scalar, BudouXKernel::SSE2, BudouXKernel::AVX2};
+
+		static constexpr StringView Name(BudouXKernel kernel) noexcept {
+			switch (kernel)
+			{
+			case BudouXKernel::SSE2:
+				return U"SSE2";
+			case BudouXKernel::AVX2:
+				return U"AVX2";
+			default:
+				return U"Scalar";
+			}
+		}
+
+		/// @brief この CPU で使えるカーネルのうち、最も速いもの
+		static BudouXKernel Detect() noexcept {
+#ifdef TOMOLATOON_BUDOUX_X64
+#	ifdef _MSC_VER
+			int info[4];
+
+			__cpuid(info, 0);
+			const int maxLeaf = info[0];
+
+			__cpuid(info, 1);
+			const bool osxsave = ((info[2] >> 27) & 1);
+			const bool avx     = ((info[2] >> 28) & 1);
+
+			// AVX のレジスタを OS が保存してくれる場合だけ AVX2 を使う
+			if (7 <= maxLeaf && osxsave && avx && ((_xgetbv(0) & 0x6) == 0x6))
+			{
+				__cpuidex(info, 7, 0);
+
+				if ((info[1] >> 5) & 1)
+				{ return BudouXKernel::AVX2; }
+			}
+#	else
+			__builtin_cpu_init();
+
+			if (__builtin_cpu_supports("avx2"))
+			{ return BudouXKernel::AVX2; }
+#	endif
+			// x64 では SSE2 は必ず使える
+			return BudouXKernel::SSE2;
+#else
+			return BudouXKernel::Scalar;
+#endif
+		}
+
+		/// @brief この CPU で kernel が使えれば true
+		static bool IsSupported(BudouXKernel kernel) noexcept {
+			return (kernel <= Detected());
+		}
+
+		/// @brief 今使われているカーネル
+		static BudouXKernel GetKernel() noexcept {
+			return Active().load(std::memory_order_relaxed);
+		}
+
+		/// @brief 使うカーネルを変える
+		/// @return kernel がこの CPU で使えなければ何もせずに false
+		static bool SetKernel(BudouXKernel kernel) noexcept {
+			if (not IsSupported(kernel))
+			{ return false; }
+
+			Active().store(kernel, std::memory_order_relaxed);
+
+			return true;
+		}
+
+		/// @brief SetKernel による変更を取り消し、Detect の結果に戻す
+		static void ResetKernel() noexcept {
+			Active().store(Detected(), std::memory_order_relaxed);
+		}
+
+		static ThresholdFunction GetThresholdFunction(BudouXKernel kernel) noexcept {
+#ifdef TOMOLATOON_BUDOUX_X64
+			switch (kernel)
+			{
+			case BudouXKernel::SSE2:
+				return detail::BudouXThresholdSSE2;
+			case BudouXKernel::AVX2:
+				return detail::BudouXThresholdAVX2;
+			default:
+				break;
+			}
+#endif
+			return detail::BudouXThresholdScalar;
+		}
+
+	private:
+
+		static BudouXKernel Detected() noexcept {
+			static const BudouXKernel kernel = Detect();
+
+			return kernel;
+		}
+
+		static std::atomic<BudouXKernel>& Active() noexcept {
+			static std::atomic<BudouXKernel> kernel{Detected()};
+
+			return kernel;
+		}
+	};
+
+	/// @brief BasicBudouXParser に与える Feature の一覧の要件
+	/// @details
+	/// T::Features は (Feature のキー, target からの相対位置, 文字数) の constexpr な配列であること
+	template <class T>
+	concept BudouXFeatureSet = requires {
+		{ std::get<0>(T::Features[0]) } -> std::convertible_to<StringView>;
+		{ std::get<1>(T::Features[0]) } -> std::convertible_to<int32>;
+		{ std::get<2>(T::Features[0]) } -> std::convertible_to<int32>;
+		typename std::integral_constant<size_t, std::size(T::Features)>;
+	};
+
+	/// @brief BudouX のモデルが持つ Feature の一覧
+	struct BudouXFeatures
+	{
+		// (Feature のキー, target からの相対位置, 文字数)
+		static constexpr std::tuple<StringView, int32, int32> Features[]{
+			{U"UW1", -3, 1},
+			{U"UW2", -2, 1},
+			{U"UW3", -1, 1},
+			{U"UW4",  0, 1},
+			{U"UW5",  1, 1},
+			{U"UW6",  2, 1},
+			{U"BW1", -2, 2},
+			{U"BW2", -1, 2},
+			{U"BW3",  0, 2},
+			{U"TW1", -3, 3},
+			{U"TW2", -2, 3},
+			{U"TW3", -1, 3},
+			{U"TW4",  0, 3},
+		};
+	};
+
+	/// @brief BudouXParser の内部の計測を行うためのカウンタ
+	/// @details
+	/// TOMOLATOON_BUDOUX_INSTRUMENTATION を定義してビルドした場合のみ計測を行い、
+	/// 定義しなかった場合は計測のコードそのものが消える。
+	/// カウンタはスレッドごとに持ち、Aggregate を呼んだ時に全てのスレッドの分を集計する。
+	/// Reset も全てのスレッドのカウンタを 0 に戻すので、他のスレッドで解析した分も含めて読み書きできる。
+	struct BudouXInstrumentation
+	{
+#ifdef TOMOLATOON_BUDOUX_INSTRUMENTATION
+		static constexpr bool Enabled = true;
+#else
+		static constexpr bool Enabled = false;
+#endif
+
+		static constexpr size_t MaxFeatures = 16;
+
+		struct Counters
+		{
+			// Feature ごとの検索回数・ヒット回数・スコアの絶対値の合計
+			std::array<uint64, MaxFeatures> lookups        = {};
+			std::array<uint64, MaxFeatures> hits           = {};
+			std::array<uint64, MaxFeatures> scoreMagnitude = {};
+
+			uint64 getScoreCalls = 0;
+
+			// parseBoundaries でスコアの計算にかかった時間
+			uint64 scoringNanoseconds = 0;
+
+			uint64 parseCalls = 0;
+
+			// parse / parseView で結果の配列を作るのにかかった時間
+			uint64 buildNanoseconds = 0;
+
+			Counters& operator+=(const Counters& other) {
+				for (size_t i = 0; i < MaxFeatures; ++i)
+				{
+					lookups[i]        += Load(other.lookups[i]);
+					hits[i]           += Load(other.hits[i]);
+					scoreMagnitude[i] += Load(other.scoreMagnitude[i]);
+				}
+
+				getScoreCalls      += Load(other.getScoreCalls);
+				scoringNanoseconds += Load(other.scoringNanoseconds);
+				parseCalls         += Load(other.parseCalls);
+				buildNanoseconds   += Load(other.buildNanoseconds);
+
+				return *this;
+			}
+
+			// other は Registry の中の値で、所有スレッドからは書き込まれない
+			Counters& operator-=(const Counters& other) {
+				for (size_t i = 0; i < MaxFeatures; ++i)
+				{
+					lookups[i]        -= other.lookups[i];
+					hits[i]           -= other.hits[i];
+					scoreMagnitude[i] -= other.scoreMagnitude[i];
+				}
+
+				getScoreCalls      -= other.getScoreCalls;
+				scoringNanoseconds -= other.scoringNanoseconds;
+				parseCalls         -= other.parseCalls;
+				buildNanoseconds   -= other.buildNanoseconds;
+
+				return *this;
+			}
+		};
+
+		/// @brief 呼び出したスレッドのカウンタ
+		static Counters& Local() {
+			thread_local LocalCounters local;
+			return local.counters;
+		}
+
+		/// @brief 全てのスレッドのカウンタを集計する
+		static Counters Aggregate() {
+			auto& registry = GetRegistry();
+
+			std::lock_guard lock{registry.mutex};
+
+			Counters result = Sum(registry);
+			result -= registry.baseline;
+
+			return result;
+		}
+
+		/// @brief 全てのスレッドのカウンタを 0 に戻す
+		/// @details カウンタには所有スレッドしか書き込まないので、その時点の合計を覚えておき、Aggregate で差し引く
+		static void Reset() {
+			auto& registry = GetRegistry();
+
+			std::lock_guard lock{registry.mutex};
+
+			registry.baseline = Sum(registry);
+		}
+
+		/// @brief カウンタを所有スレッドから加算する
+		/// @note 書き込むのは所有スレッドだけなので、fetch_add は要らない。Aggregate が読めるように不可分に読み書きする
+		static void Add(uint64& counter, uint64 value) noexcept {
+			std::atomic_ref ref{counter};
+			ref.store((ref.load(std::memory_order_relaxed) + value), std::memory_order_relaxed);
+		}
+
+		static uint64 Load(const uint64& counter) noexcept {
+			return std::atomic_ref{const_cast<uint64&>(counter)}.load(std::memory_order_relaxed);
+		}
+
+		/// @brief 計測が有効な場合のみ現在時刻を取得する
+		static std::chrono::steady_clock::time_point Now() noexcept {
+			if constexpr (Enabled)
+			{ return std::chrono::steady_clock::now(); }
+			else
+			{ return {}; }
+		}
+
+		static uint64 ElapsedNanoseconds(std::chrono::steady_clock::time_point start) noexcept {
+			const auto elapsed = (std::chrono::steady_clock::now() - start);
+
+			return static_cast<uint64>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()
+			);
+		}
+
+		/// @brief カウンタを JSON にする
+		/// @tparam FeatureSet 計測した BasicBudouXParser の Feature の一覧
+		template <BudouXFeatureSet FeatureSet = BudouXFeatures>
+		static JSON ToJSON(const Counters& counters = Aggregate()) {
+			JSON json;
+
+			for (size_t i = 0; i < std::size(FeatureSet::Features); ++i)
+			{
+				const uint64 lookups   = counters.lookups[i];
+				const uint64 hits      = counters.hits[i];
+				const double magnitude = static_cast<double>(counters.scoreMagnitude[i]);
+
+				JSON feature;
+				feature[U"name"]                  = std::get<0>(FeatureSet::Features[i]);
+				feature[U"lookups"]               = lookups;
+				feature[U"hits"]                  = hits;
+				feature[U"misses"]                = (lookups - hits);
+				feature[U"averageScoreMagnitude"] = hits ? (magnitude / hits) : 0.0;
+
+				json[U"features"].push_back(feature);
+			}
+
+			json[U"getScoreCalls"]  = counters.getScoreCalls;
+			json[U"scoringSeconds"] = (counters.scoringNanoseconds / 1e9);
+			json[U"parseCalls"]     = counters.parseCalls;
+			json[U"buildSeconds"]   = (counters.buildNanoseconds / 1e9);
+
+			return json;
+		}
+
+	private:
+
+		struct Registry
+		{
+			std::mutex mutex;
+
+			Array<Counters*> live;
+
+			// 終了したスレッドのカウンタ
+			Counters retired;
+
+			// 最後に Reset した時点の合計
+			Counters baseline;
+		};
+
+		struct LocalCounters
+		{
+			Counters counters;
+
+			LocalCounters() {
+				auto& registry = GetRegistry();
+
+				std::lock_guard lock{registry.mutex};
+
+				registry.live.push_back(&counters);
+			}
+
+			~LocalCounters() {
+				auto& registry = GetRegistry();
+
+				std::lock_guard lock{registry.mutex};
+
+				registry.retired += counters;
+				registry.live.remove(&counters);
+			}
+		};
+
+		static Registry& GetRegistry() {
+			static Registry registry;
+			return registry;
+		}
+
+		// registry.mutex を取ってから呼ぶこと
+		static Counters Sum(const Registry& registry) {
+			Counters result = registry.retired;
+
+			for (const auto* counters : registry.live)
+			{ result += *counters; }
+
+			return result;
+		}
+	};
+
+	/// @brief BudouX のモデルで文を文節に分割するパーサー
+	/// @tparam FeatureSet 使う Feature の一覧（BudouXFeatureSet）
+	/// @details
+	/// Feature の一覧はコンパイル時に決まるので、getScore のループは展開され、
+	/// 全ての Feature が文の範囲内に収まる位置（文の先頭と末尾の数文字以外）では範囲の確認も省かれる。
+	template <BudouXFeatureSet FeatureSet = BudouXFeatures>
+	struct BasicBudouXParser
 	{
 		using Model = HashTable<String, HashTable<String, int32>>;
 
-		BudouXParser(Model model, Optional<int32> totalScore = none)
+		BasicBudouXParser(Model model, Optional<int32> totalScore = none)
 			: m_totalScore{totalScore.value_or(0)}, m_model{std::move(model)} {
 			if (not totalScore)
 			{
@@ -17,64 +461,76 @@ namespace tomolatoon
 					for (const auto& [sequence, score] : group) { m_totalScore += score; }
 				}
 			}
+
+			resolveGroups();
 		}
 
-		BudouXParser() = default;
+		BasicBudouXParser() = default;
 
-		BudouXParser(const BudouXParser&) = default;
+		// m_groups は m_model の中を指すので、コピーやムーブの後は引き直す
 
-		BudouXParser(BudouXParser&&) = default;
+		BasicBudouXParser(const BasicBudouXParser& other)
+			: m_totalScore{other.m_totalScore}, m_model{other.m_model} {
+			resolveGroups();
+		}
 
-		BudouXParser& operator=(const BudouXParser&) = default;
+		BasicBudouXParser(BasicBudouXParser&& other) noexcept
+			: m_totalScore{other.m_totalScore}, m_model{std::move(other.m_model)} {
+			resolveGroups();
+			other.resolveGroups();
+		}
+
+		BasicBudouXParser& operator=(const BasicBudouXParser& other) {
+			m_totalScore = other.m_totalScore;
+			m_model      = other.m_model;
+			resolveGroups();
+
+			return *this;
+		}
 
-		BudouXParser& operator=(BudouXParser&&) = default;
+		BasicBudouXParser& operator=(BasicBudouXParser&& other) noexcept {
+			m_totalScore = other.m_totalScore;
+			m_model      = std::move(other.m_model);
+			resolveGroups();
+			other.resolveGroups();
+
+			return *this;
+		}
 
 		explicit operator bool() const {
 			return (not m_model.empty());
 		}
 
-		int32 getFeatureScore(StringView featureKey, StringView sequence) const {
-			if (const auto itGroup = m_model.find(featureKey); itGroup != m_model.end())
-			{
-				const auto& group = itGroup->second;
+		static constexpr const auto& Features = FeatureSet::Features;
 
-				if (const auto itScore = group.find(sequence); itScore != group.end())
-				{
-					const auto& score = itScore->second;
+		static_assert(std::size(Features) <= BudouXInstrumentation::MaxFeatures);
 
-					return score;
-				}
-			}
+		int32 getFeatureScore(StringView featureKey, StringView sequence) const {
+			const int32* score = findFeatureScore(featureKey, sequence);
 
-			return 0;
+			return score ? *score : 0;
 		}
 
 		// target で指定された文字について、全ての Feature におけるスコアを合計した値を返す
 		int32 getScore(StringView sequence, int64 target) const {
-			constexpr std::tuple<StringView, int32, int32> Features[]{
-				{U"UW1", -3, 1},
-				{U"UW2", -2, 1},
-				{U"UW3", -1, 1},
-				{U"UW4",  0, 1},
-				{U"UW5",  1, 1},
-				{U"UW6",  2, 1},
-				{U"BW1", -2, 2},
-				{U"BW2", -1, 2},
-				{U"BW3",  0, 2},
-				{U"TW1", -3, 3},
-				{U"TW2", -2, 3},
-				{U"TW3", -1, 3},
-				{U"TW4",  0, 3},
-			};
-
 			int32 score = 0;
 
-			for (const auto& [key, pos, n] : Features)
+			if ((0 <= (target + MinOffset)) && ((target + MaxEnd) <= static_cast<int64>(sequence.size())))
+			{
+				[&]<size_t... I>(std::index_sequence<I...>) {
+					((score += getFeatureScore<I, false>(sequence, target)), ...);
+				}(std::make_index_sequence<std::size(Features)>{});
+			}
+			else
 			{
-				if ((0 <= (target + pos)) && ((target + pos) < static_cast<int64>(sequence.size())))
-				{ score += getFeatureScore(key, sequence.substr((target + pos), n)); }
+				[&]<size_t... I>(std::index_sequence<I...>) {
+					((score += getFeatureScore<I, true>(sequence, target)), ...);
+				}(std::make_index_sequence<std::size(Features)>{});
 			}
 
+			if constexpr (BudouXInstrumentation::Enabled)
+			{ BudouXInstrumentation::Add(BudouXInstrumentation::Local().getScoreCalls, 1); }
+
 			return score;
 		}
 
@@ -87,46 +543,84 @@ namespace tomolatoon
 		}
 
 		Array<size_t> parseBoundaries(StringView sentence) const {
+			[[maybe_unused]] const auto start = BudouXInstrumentation::Now();
+
 			Array<size_t> result;
 
-			for (int64 i = 1; i < static_cast<int64>(sentence.size()); ++i)
+			const auto threshold = BudouXKernels::GetThresholdFunction(BudouXKernels::GetKernel());
+
+			// score * 2 > m_totalScore と score > floor(m_totalScore / 2) は同じ
+			const int32 border = (m_totalScore >> 1);
+
+			// 64 文字ずつスコアを求め、閾値判定はまとめてカーネルで行う
+			std::array<int32, 64> scores;
+
+			for (size_t block = 1; block < sentence.size(); block += scores.size())
 			{
-				if (overBoundaryScore(getScore(sentence, i)))
-				{ result.push_back(i); }
+				const size_t count = Min(scores.size(), (sentence.size() - block));
+
+				for (size_t k = 0; k < count; ++k)
+				{ scores[k] = getScore(sentence, static_cast<int64>(block + k)); }
+
+				for (uint64 mask = threshold(scores.data(), count, border); mask != 0; mask &= (mask - 1))
+				{ result.push_back(block + std::countr_zero(mask)); }
+			}
+
+			if constexpr (BudouXInstrumentation::Enabled)
+			{
+				BudouXInstrumentation::Add(
+					BudouXInstrumentation::Local().scoringNanoseconds,
+					BudouXInstrumentation::ElapsedNanoseconds(start)
+				);
 			}
+
 			return result;
 		}
 
 		Array<String> parse(StringView sentence) const {
+			const auto boundaries = parseBoundaries(sentence);
+
+			[[maybe_unused]] const auto start = BudouXInstrumentation::Now();
+
 			Array<String> result;
 
-			size_t start = 0;
+			size_t begin = 0;
 
-			for (size_t boundary : parseBoundaries(sentence))
+			for (size_t boundary : boundaries)
 			{
-				result.emplace_back(sentence.substr(start, (boundary - start)));
+				result.emplace_back(sentence.substr(begin, (boundary - begin)));
 
-				start = boundary;
+				begin = boundary;
 			}
 
-			result.emplace_back(sentence.substr(start));
+			result.emplace_back(sentence.substr(begin));
+
+			if constexpr (BudouXInstrumentation::Enabled)
+			{ RecordBuild(start); }
 
 			return result;
 		}
 
 		Array<StringView> parseView(StringView sentence) const {
+			const auto boundaries = parseBoundaries(sentence);
+
+			[[maybe_unused]] const auto start = BudouXInstrumentation::Now();
+
 			Array<StringView> result;
 
-			size_t start = 0;
+			size_t begin = 0;
 
-			for (size_t boundary : parseBoundaries(sentence))
+			for (size_t boundary : boundaries)
 			{
-				result.push_back(sentence.substr(start, (boundary - start)));
+				result.push_back(sentence.substr(begin, (boundary - begin)));
 
-				start = boundary;
+				begin = boundary;
 			}
 
-			result.push_back(sentence.substr(start));
+			result.push_back(sentence.substr(begin));
+
+			if constexpr (BudouXInstrumentation::Enabled)
+			{ RecordBuild(start); }
 
 			return result;
 		}
@@ -139,13 +633,18 @@ namespace tomolatoon
 			return m_model;
 		}
 
-		Model&& getModel() && {
-			return std::move(m_model);
+		Model getModel() && {
+			Model model = std::move(m_model);
+			resolveGroups();
+
+			return model;
 		}
 
-		friend bool operator==(const BudouXParser& lhs, const BudouXParser& rhs) = default;
+		friend bool operator==(const BasicBudouXParser& lhs, const BasicBudouXParser& rhs) {
+			return (lhs.m_totalScore == rhs.m_totalScore && lhs.m_model == rhs.m_model);
+		}
 
-		static BudouXParser Parse(const JSON& modelJSON) {
+		static BasicBudouXParser Parse(const JSON& modelJSON) {
 			Model model;
 			int32 totalScore = 0;
 
@@ -155,7 +654,7 @@ namespace tomolatoon
 
 				for (const auto& [sequence, scoreJSON] : groupJSON)
 				{
-					const int32 score = scoreJSON.getOr<int32>(0);
+					const int32 score = scoreJSON.template getOr<int32>(0);
 
 					group[sequence] = score;
 
@@ -163,19 +662,19 @@ namespace tomolatoon
 				}
 			}
 
-			return BudouXParser{std::move(model), totalScore};
+			return BasicBudouXParser{std::move(model), totalScore};
 		}
 
 		template <class Reader, std::enable_if_t<std::is_base_of_v<IReader, Reader>>* = nullptr>
-		static BudouXParser Load(Reader&& reader) {
+		static BasicBudouXParser Load(Reader&& reader) {
 			return Parse(JSON::Load(std::forward<Reader>(reader)));
 		}
 
-		static BudouXParser Load(FilePathView path) {
+		static BasicBudouXParser Load(FilePathView path) {
 			return Load(BinaryReader{path});
 		}
 
-		static BudouXParser Download(URLView url) {
+		static BasicBudouXParser Download(URLView url) {
 			MemoryWriter writer;
 
 			SimpleHTTP::Get(url, {}, writer);
@@ -185,17 +684,120 @@ namespace tomolatoon
 
 	private:
 
+		// 全ての Feature の中で最も前の位置と、最も後ろの終わり
+		static constexpr int64 MinOffset = [] {
+			int64 result = 0;
+
+			for (const auto& [key, pos, n] : Features)
+			{ result = Min<int64>(result, pos); }
+
+			return result;
+		}();
+
+		static constexpr int64 MaxEnd = [] {
+			int64 result = 0;
+
+			for (const auto& [key, pos, n] : Features)
+			{ result = Max<int64>(result, (pos + n)); }
+
+			return result;
+		}();
+
+		using Group = HashTable<String, int32>;
+
+		// 各 Feature のスコアの表を、Features と同じ順に引いておく（モデルに無ければ nullptr）
+		void resolveGroups() {
+			for (size_t i = 0; i < std::size(Features); ++i)
+			{
+				const auto it = m_model.find(std::get<0>(Features[i]));
+
+				m_groups[i] = ((it != m_model.end()) ? std::addressof(it->second) : nullptr);
+			}
+		}
+
+		// I 番目の Feature のスコア。Checked が false なら、Feature が文の範囲内に収まっていること
+		// Feature の表は resolveGroups で引いてあるので、ここではキーの文字列をハッシュしない
+		template <size_t I, bool Checked>
+		int32 getFeatureScore(StringView sequence, int64 target) const {
+			constexpr int64      Pos = std::get<1>(Features[I]);
+			constexpr size_t     N   = std::get<2>(Features[I]);
+
+			const int64 begin = (target + Pos);
+
+			if constexpr (Checked)
+			{
+				if ((begin < 0) || (static_cast<int64>(sequence.size()) <= begin))
+				{ return 0; }
+			}
+
+			const Group* group = m_groups[I];
+
+			const int32* featureScore = nullptr;
+
+			if (group)
+			{
+				const StringView key = (Checked ? sequence.substr(begin, N) : StringView{(sequence.data() + begin), N});
+
+				if (const auto it = group->find(key); it != group->end())
+				{ featureScore = std::addressof(it->second); }
+			}
+
+			if constexpr (BudouXInstrumentation::Enabled)
+			{
+				auto& counters = BudouXInstrumentation::Local();
+
+				BudouXInstrumentation::Add(counters.lookups[I], 1);
+
+				if (featureScore)
+				{
+					BudouXInstrumentation::Add(counters.hits[I], 1);
+					BudouXInstrumentation::Add(
+						counters.scoreMagnitude[I],
+						static_cast<uint64>(Abs(*featureScore))
+					);
+				}
+			}
+
+			return featureScore ? *featureScore : 0;
+		}
+
+		const int32* findFeatureScore(StringView featureKey, StringView sequence) const {
+			if (const auto itGroup = m_model.find(featureKey); itGroup != m_model.end())
+			{
+				const auto& group = itGroup->second;
+
+				if (const auto itScore = group.find(sequence); itScore != group.end())
+				{ return std::addressof(itScore->second); }
+			}
+
+			return nullptr;
+		}
+
+		static void RecordBuild(std::chrono::steady_clock::time_point start) {
+			auto& counters = BudouXInstrumentation::Local();
+
+			BudouXInstrumentation::Add(counters.parseCalls, 1);
+			BudouXInstrumentation::Add(
+				counters.buildNanoseconds,
+				BudouXInstrumentation::ElapsedNanoseconds(start)
+			);
+		}
+
 		int32 m_totalScore = 0;
 
 		Model m_model = {};
+
+		std::array<const Group*, std::size(Features)> m_groups = {};
 	};
 
+	using BudouXParser = BasicBudouXParser<>;
+
 	struct as_sentinel_tag
 	{};
 
 	template <std::ranges::input_range View>
 	requires std::ranges::view<View>
-	      && requires { requires sizeof std::ranges::range_value_t<View> == 4; }
+	      && requires { requires (sizeof(std::ranges::range_value_t<View>) == 4); }
 	struct BudouXBreakView: std::ranges::view_interface<BudouXBreakView<View>>
 	{
 		template <bool IsConst>
@@ -502,6 +1104,69 @@ namespace tomolatoon
 				  BudouXBreakView<std::views::all_t<String>>::iterator<true>>);
 } // namespace tomolatoon
 
+namespace tomolatoon
+{
+	/// @brief 全てのカーネルで parseBoundaries の結果が、1 文字ずつ parseCharacter で判定した結果と一致するか調べる
+	/// @details カーネル単体についても、閾値の前後や int32 の端の値で Scalar と一致するか調べる
+	/// @note 調べている間はカーネルを切り替えるので、他のスレッドで BudouXParser を使わないこと
+	inline bool VerifyBudouXKernels(const BudouXParser& parser, StringView text) {
+		Array<size_t> reference;
+
+		for (int64 i = 1; i < static_cast<int64>(text.size()); ++i)
+		{
+			if (parser.parseCharacter(text, i))
+			{ reference.push_back(i); }
+		}
+
+		constexpr int32 Thresholds[] = {
+			std::numeric_limits<int32>::min(),
+			-1,
+			0,
+			1,
+			std::numeric_limits<int32>::max(),
+		};
+
+		std::array<int32, 64> scores;
+
+		const BudouXKernel previous = BudouXKernels::GetKernel();
+
+		bool result = true;
+
+		for (const BudouXKernel kernel : BudouXKernels::All)
+		{
+			if (not BudouXKernels::SetKernel(kernel))
+			{ continue; }
+
+			result = (result && parser.parseBoundaries(text) == reference);
+
+			for (const int32 threshold : Thresholds)
+			{
+				for (size_t i = 0; i < scores.size(); ++i)
+				{
+					const int64 offset = (static_cast<int64>(i % 3) - 1);
+
+					scores[i] = static_cast<int32>(Clamp<int64>(
+						(threshold + offset),
+						std::numeric_limits<int32>::min(),
+						std::numeric_limits<int32>::max()
+					));
+				}
+
+				for (size_t count = 0; count <= scores.size(); ++count)
+				{
+					result = (result
+					          && BudouXKernels::GetThresholdFunction(kernel)(scores.data(), count, threshold)
+					                 == detail::BudouXThresholdScalar(scores.data(), count, threshold));
+				}
+			}
+		}
+
+		BudouXKernels::SetKernel(previous);
+
+		return result;
+	}
+} // namespace tomolatoon
+
 namespace tomolatoon::detail
 {
 	struct BudouXBreakAdaptor: rivet::range_adaptor_base<BudouXBreakAdaptor>
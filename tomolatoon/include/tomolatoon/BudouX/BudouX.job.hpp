@@ -0,0 +1,112 @@
+﻿#pragma once
+#include <ranges>
+#include <Siv3D.hpp>
+#include "BudouX.hpp"
+
+namespace tomolatoon
+{
+	/// @brief 長いテキストの分割を、1 回あたりの時間予算内で少しずつ進めるジョブ
+	/// @details
+	/// 毎フレーム step を呼ぶことで、フレームを止めずに長文（小説の 1 章など）を分割できる。
+	/// 途中までの結果は confirmedSegments で取得でき、その時点で描画に使える。
+	/// @note 渡したパーサーはジョブより長く生存している必要がある
+	struct BudouXSegmentationJob
+	{
+		/// @brief 時間の計測を行う間隔（文字数）
+		static constexpr size_t CheckInterval = 64;
+
+		BudouXSegmentationJob() = default;
+
+		BudouXSegmentationJob(const BudouXParser& parser, String text)
+			: m_parser{std::addressof(parser)}, m_text{std::move(text)} {}
+
+		/// @brief budget の時間だけ分割を進める
+		/// @param budget 1 回の呼び出しで使ってよい時間
+		/// @return 全て分割し終えたら true
+		bool step(const Duration& budget) {
+			const Stopwatch stopwatch{StartImmediately::Yes};
+
+			while (not isDone())
+			{
+				const size_t last = Min((m_next + CheckInterval), m_text.size());
+
+				for (; m_next < last; ++m_next)
+				{
+					if (m_parser->parseCharacter(m_text, static_cast<int64>(m_next)))
+					{ m_boundaries.push_back(m_next); }
+				}
+
+				if (budget <= stopwatch.elapsed())
+				{ break; }
+			}
+
+			return isDone();
+		}
+
+		/// @brief 残りを全て分割する
+		void run() {
+			while (not step(Duration{1.0})) {}
+		}
+
+		/// @brief 全て分割し終えたか
+		bool isDone() const noexcept {
+			return m_text.size() <= m_next;
+		}
+
+		/// @brief 進捗 [0, 1]
+		double progress() const noexcept {
+			if (m_text.isEmpty())
+			{ return 1.0; }
+
+			return (static_cast<double>(Min(m_next, m_text.size())) / m_text.size());
+		}
+
+		/// @brief これまでに見つかった境界
+		/// @note 全て分割し終えると BudouXParser::parseBoundaries の結果と一致する
+		const Array<size_t>& boundaries() const noexcept {
+			return m_boundaries;
+		}
+
+		/// @brief 分割が確定した部分の長さ（文字単位）
+		/// @note 最後に見つかった境界までで、それより後ろは次の step で境界が見つかる可能性がある
+		size_t confirmedLength() const noexcept {
+			if (isDone())
+			{ return m_text.size(); }
+
+			return m_boundaries.isEmpty() ? 0 : m_boundaries.back();
+		}
+
+		/// @brief 分割が確定した文節を列挙する range
+		auto confirmedSegments() const {
+			const size_t count = isDone() ? (m_boundaries.size() + 1) : m_boundaries.size();
+
+			return std::views::iota(size_t{0}, (m_text.isEmpty() ? 0 : count))
+			     | std::views::transform([this](size_t i) {
+					   const size_t begin = (i == 0) ? 0 : m_boundaries[i - 1];
+					   const size_t end   = (i < m_boundaries.size()) ? m_boundaries[i] : m_text.size();
+
+					   return StringView{m_text}.substr(begin, (end - begin));
+				   });
+		}
+
+		/// @brief まだ分割が確定していない残りのテキスト
+		StringView pendingText() const {
+			return StringView{m_text}.substr(confirmedLength());
+		}
+
+		const String& text() const noexcept {
+			return m_text;
+		}
+
+	private:
+
+		const BudouXParser* m_parser = nullptr;
+
+		String m_text;
+
+		// 次に判定する位置、境界は 1 文字目以降にしか無い
+		size_t m_next = 1;
+
+		Array<size_t> m_boundaries;
+	};
+} // namespace tomolatoon
@@ -0,0 +1,349 @@
+﻿#pragma once
+#include <ranges>
+#include <span>
+#include <Siv3D.hpp>
+#include "BudouX.hpp"
+
+namespace tomolatoon
+{
+	/// @brief BudouX による文節の境界を事前計算して保持し、文節へのランダムアクセスを提供するクラス
+	/// @details
+	/// キャレット移動やページ送りのたびにパーサーを走らせずに済むようにする。
+	///
+	/// テキストと境界は、最後に編集した位置で前後に分けて持つ（ギャップバッファ）。
+	/// 後ろ側の境界はテキストの末尾からの距離で持つので、編集してもずらす必要が無い。
+	/// したがって replace の費用は、編集の大きさと、前回の編集位置からの距離に比例し、テキストの長さには依存しない。
+	/// 文節の番号や位置を引く関数もそのまま引ける。
+	/// text・boundaries・offsets・segment のように連続した配列を返す関数だけは、編集後の最初の呼び出しで O(n) かけて作り直す。
+	/// @note const の関数も内部のキャッシュを作り直すことがあるので、複数のスレッドから同時に呼ばないこと
+	struct SegmentedText
+	{
+		SegmentedText() = default;
+
+		SegmentedText(const BudouXParser& parser, String text) {
+			assign(parser, std::move(text));
+		}
+
+		/// @brief テキストを差し替えて、境界を全て計算し直す
+		void assign(const BudouXParser& parser, String text) {
+			m_before = (text.isEmpty() ? Array<size_t>{} : parser.parseBoundaries(text));
+			m_after.clear();
+
+			m_head = std::move(text);
+			m_tail.clear();
+
+			m_viewsValid = false;
+		}
+
+		/// @brief テキストの一部を置き換え、影響を受ける範囲の境界だけを計算し直す
+		/// @param offset 置き換えの開始位置（文字単位）
+		/// @param removedLength 削除する文字数
+		/// @param inserted 挿入する文字列
+		/// @details
+		/// BudouX による判定は前 3 文字と後 3 文字にしか依存しないので、
+		/// 編集箇所の前後 3 文字以内の境界だけを再判定し、それより後ろの境界は末尾からの距離のまま使う。
+		/// 費用は O(編集の大きさ + 前回の編集位置からの距離) で、テキスト全体の長さには依存しない。
+		void replace(
+			const BudouXParser& parser,
+			size_t              offset,
+			size_t              removedLength,
+			StringView          inserted
+		) {
+			const size_t oldLength = length();
+
+			if (oldLength < (offset + removedLength))
+			{ throw Error{U"[SegmentedText::replace]: range is out of text."}; }
+
+			const size_t newLength = (oldLength - removedLength + inserted.size());
+
+			// 空のテキストとの間の変化は、編集の大きさ＝テキスト全体なので単に作り直す
+			if (oldLength == 0 || newLength == 0)
+			{
+				String text{this->text()};
+				text.replace(offset, removedLength, inserted.data(), inserted.size());
+				assign(parser, std::move(text));
+				return;
+			}
+
+			// 再判定が必要な範囲 [lo, hiNew)、旧テキストでは [lo, hiOld) に相当する
+			const size_t lo    = (Max<size_t>(offset, 3) - 2);
+			const size_t hiOld = (offset + removedLength + 3);
+			const size_t hiNew = Min((offset + inserted.size() + 3), newLength);
+
+			// [lo, hiOld) の境界を捨てる。残った後ろ側は末尾からの距離なので、長さが変わってもそのまま使える
+			moveBoundaryGap(lo);
+
+			while (not m_after.isEmpty() && (oldLength - m_after.back()) < hiOld)
+			{ m_after.pop_back(); }
+
+			moveTextGap(offset);
+
+			m_tail.resize(m_tail.size() - removedLength);
+			m_head.append(inserted);
+
+			// 前後 3 文字の文脈を含めて切り出し、その中で判定する
+			const size_t windowBegin = (lo - Min<size_t>(lo, 3));
+			const size_t windowEnd   = Min((hiNew + 3), newLength);
+
+			String window;
+			window.reserve(windowEnd - windowBegin);
+
+			for (size_t i = windowBegin; i < windowEnd; ++i)
+			{ window.push_back(charAt(i)); }
+
+			for (size_t i = lo; i < hiNew; ++i)
+			{
+				if (parser.parseCharacter(window, static_cast<int64>(i - windowBegin)))
+				{ m_before.push_back(i); }
+			}
+
+			m_viewsValid = false;
+		}
+
+		/// @brief テキストを newText に更新する
+		/// @details 現在のテキストとの共通の接頭辞・接尾辞を除いた部分を編集とみなして replace を呼ぶ。
+		/// 毎フレーム TextAreaEditState::text を渡すような使い方を想定している
+		/// @note 接頭辞・接尾辞を求めるために両方のテキストを比べるので O(n)。
+		/// テキストが変わった時だけ呼ぶか、編集範囲が分かっている場合は範囲を渡す方を使うこと
+		void update(const BudouXParser& parser, StringView newText) {
+			const StringView oldText = text();
+
+			const size_t maxCommon = Min(oldText.size(), newText.size());
+
+			size_t prefix = 0;
+			while (prefix < maxCommon && oldText[prefix] == newText[prefix])
+			{ ++prefix; }
+
+			if (prefix == oldText.size() && prefix == newText.size())
+			{ return; }
+
+			size_t suffix = 0;
+			while ((prefix + suffix) < maxCommon
+			       && oldText[oldText.size() - suffix - 1] == newText[newText.size() - suffix - 1])
+			{ ++suffix; }
+
+			replace(
+				parser,
+				prefix,
+				(oldText.size() - prefix - suffix),
+				newText.substr(prefix, (newText.size() - prefix - suffix))
+			);
+		}
+
+		/// @brief 旧テキストの [offset, offset + removedLength) を置き換えて newText になったとして更新する
+		/// @details テキスト全体を比べずに、newText の挿入された部分だけを読んで replace を呼ぶ
+		void update(const BudouXParser& parser, StringView newText, size_t offset, size_t removedLength) {
+			if ((newText.size() + removedLength) < length() || newText.size() < offset)
+			{ throw Error{U"[SegmentedText::update]: range is out of text."}; }
+
+			replace(parser, offset, removedLength, newText.substr(offset, (newText.size() + removedLength - length())));
+		}
+
+		/// @brief 文節の数
+		/// @note 空のテキストは文節を持たない
+		size_t size() const noexcept {
+			return (length() == 0 ? 0 : (boundaryCount() + 1));
+		}
+
+		bool isEmpty() const noexcept {
+			return size() == 0;
+		}
+
+		/// @brief テキストの長さ（文字数）
+		size_t length() const noexcept {
+			return (m_head.size() + m_tail.size());
+		}
+
+		/// @brief i 番目の文節
+		StringView operator[](size_t i) const {
+			return segment(i);
+		}
+
+		/// @brief i 番目の文節
+		/// @note 編集後の最初の呼び出しでは、テキストを連続した String に作り直す（O(n)）
+		StringView segment(size_t i) const {
+			return StringView{text()}.substr(segmentBegin(i), (segmentEnd(i) - segmentBegin(i)));
+		}
+
+		/// @brief i 番目の文節の開始位置（文字単位）
+		size_t segmentBegin(size_t i) const {
+			return (i == 0 ? 0 : boundary(i - 1));
+		}
+
+		/// @brief i 番目の文節の終了位置（文字単位、終端を含まない）
+		size_t segmentEnd(size_t i) const {
+			return (i < boundaryCount() ? boundary(i) : length());
+		}
+
+		/// @brief charIndex 番目の文字を含む文節の番号を返す
+		/// @note charIndex がテキストの長さ以上の場合は最後の文節を返す。O(log n)
+		size_t segmentAt(size_t charIndex) const {
+			if (isEmpty())
+			{ throw Error{U"[SegmentedText::segmentAt]: text is empty."}; }
+
+			return countBoundaries([charIndex](size_t b) { return (b <= charIndex); });
+		}
+
+		/// @brief charIndex より後ろにある最初の境界（無ければテキストの長さ）を返す
+		size_t next(size_t charIndex) const {
+			const size_t k = countBoundaries([charIndex](size_t b) { return (b <= charIndex); });
+
+			return (k < boundaryCount()) ? boundary(k) : length();
+		}
+
+		/// @brief charIndex より前にある最後の境界（無ければ 0）を返す
+		/// @note charIndex がテキストの長さより大きい場合は、テキストの長さを返す
+		size_t prev(size_t charIndex) const {
+			if (length() < charIndex)
+			{ return length(); }
+
+			const size_t k = countBoundaries([charIndex](size_t b) { return (b < charIndex); });
+
+			return (k != 0) ? boundary(k - 1) : 0;
+		}
+
+		/// @brief 全ての文節を StringView として列挙するランダムアクセス range
+		auto segments() const {
+			return std::views::iota(size_t{0}, size())
+			     | std::views::transform([this](size_t i) { return segment(i); });
+		}
+
+		/// @brief 文節どうしの境界
+		/// @note BudouXParser::parseBoundaries の結果と同じもの。編集後の最初の呼び出しでは O(n)
+		std::span<const size_t> boundaries() const {
+			if (isEmpty())
+			{ return {}; }
+
+			const auto& all = offsets();
+
+			return std::span{all}.subspan(1, (all.size() - 2));
+		}
+
+		/// @brief 文節の境界
+		/// @note BudouXParser::parseBoundaries の結果の前後に 0 とテキストの長さを加えたもの。編集後の最初の呼び出しでは O(n)
+		const Array<size_t>& offsets() const {
+			updateViews();
+
+			return m_offsets;
+		}
+
+		/// @brief テキスト
+		/// @note 編集後の最初の呼び出しでは O(n)
+		const String& text() const {
+			updateViews();
+
+			return m_text;
+		}
+
+	private:
+
+		size_t boundaryCount() const noexcept {
+			return (m_before.size() + m_after.size());
+		}
+
+		// k 番目の境界
+		size_t boundary(size_t k) const noexcept {
+			if (k < m_before.size())
+			{ return m_before[k]; }
+
+			return (length() - m_after[m_after.size() - 1 - (k - m_before.size())]);
+		}
+
+		// pred を満たす境界の数。境界は昇順なので、pred が前から順に満たされるなら二分探索で求まる
+		template <class Pred>
+		size_t countBoundaries(Pred pred) const {
+			size_t first = 0;
+			size_t last  = boundaryCount();
+
+			while (first < last)
+			{
+				const size_t middle = (first + (last - first) / 2);
+
+				if (pred(boundary(middle)))
+				{ first = (middle + 1); }
+				else
+				{ last = middle; }
+			}
+
+			return first;
+		}
+
+		char32 charAt(size_t i) const noexcept {
+			return (i < m_head.size()) ? m_head[i] : m_tail[m_tail.size() - 1 - (i - m_head.size())];
+		}
+
+		// テキストの切れ目を pos に動かす
+		void moveTextGap(size_t pos) {
+			while (pos < m_head.size())
+			{
+				m_tail.push_back(m_head.back());
+				m_head.pop_back();
+			}
+
+			while (m_head.size() < pos)
+			{
+				m_head.push_back(m_tail.back());
+				m_tail.pop_back();
+			}
+		}
+
+		// pos より前の境界を m_before に、pos 以降の境界を m_after に移す
+		void moveBoundaryGap(size_t pos) {
+			const size_t n = length();
+
+			while (not m_before.isEmpty() && pos <= m_before.back())
+			{
+				m_after.push_back(n - m_before.back());
+				m_before.pop_back();
+			}
+
+			while (not m_after.isEmpty() && (n - m_after.back()) < pos)
+			{
+				m_before.push_back(n - m_after.back());
+				m_after.pop_back();
+			}
+		}
+
+		// 連続した String と境界の配列を作り直す
+		void updateViews() const {
+			if (m_viewsValid)
+			{ return; }
+
+			m_text.assign(m_head.begin(), m_head.end());
+			m_text.append(m_tail.rbegin(), m_tail.rend());
+
+			m_offsets.clear();
+			m_offsets.push_back(0);
+
+			for (size_t k = 0; k < boundaryCount(); ++k)
+			{ m_offsets.push_back(boundary(k)); }
+
+			if (not m_text.isEmpty())
+			{ m_offsets.push_back(m_text.size()); }
+
+			m_viewsValid = true;
+		}
+
+		// 切れ目より前のテキスト
+		String m_head;
+
+		// 切れ目より後ろのテキストを、逆順に持つ（末尾が切れ目の直後の文字）
+		String m_tail;
+
+		// 切れ目より前の境界（昇順）
+		Array<size_t> m_before;
+
+		// 切れ目より後ろの境界の、テキストの末尾からの距離（昇順、末尾が切れ目に最も近い境界）
+		Array<size_t> m_after;
+
+		mutable String m_text;
+
+		// [0, 境界..., テキストの長さ]（空のテキストでは [0]）
+		mutable Array<size_t> m_offsets = {0};
+
+		mutable bool m_viewsValid = true;
+	};
+
+	static_assert(std::ranges::random_access_range<
+				  decltype(std::declval<const SegmentedText&>().segments())>);
+} // namespace tomolatoon
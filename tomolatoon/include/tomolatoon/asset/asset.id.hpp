@@ -0,0 +1,225 @@
+﻿#pragma once
+#include <algorithm>
+#include <compare>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <Siv3D.hpp>
+
+// AssetID から元の名前を引けるようにするか（既定ではデバッグビルドのみ）
+#if !defined(TOMOLATOON_ASSET_ID_NAMES)
+#	if defined(_DEBUG)
+#		define TOMOLATOON_ASSET_ID_NAMES 1
+#	else
+#		define TOMOLATOON_ASSET_ID_NAMES 0
+#	endif
+#endif
+
+namespace tomolatoon::detail
+{
+	// 文字列リテラルをテンプレート引数として受け取るための型
+	template <class CharType, size_t N>
+	struct AssetIDLiteral
+	{
+		constexpr AssetIDLiteral(const CharType (&s)[N]) noexcept {
+			std::copy_n(s, N, chars);
+		}
+
+		CharType chars[N] = {};
+
+		// 終端の '\0' を除いた長さ
+		static constexpr size_t Length = (N - 1);
+	};
+
+	constexpr uint64 FNV1aOffsetBasis = 0xCBF2'9CE4'8422'2325;
+
+	constexpr uint64 FNV1aPrime = 0x0000'0100'0000'01B3;
+
+	// 符号位置を 4 バイトとして FNV-1a に混ぜる
+	constexpr uint64 HashCodePoint(uint64 hash, char32 ch) noexcept {
+		for (int32 shift = 0; shift < 32; shift += 8)
+		{ hash = ((hash ^ ((ch >> shift) & 0xFF)) * FNV1aPrime); }
+
+		return hash;
+	}
+
+	// 名前の符号位置の列をハッシュする
+	// UTF-8 の文字列は、UTF-32 にした場合と同じ値になるように復号しながらハッシュする
+	template <class CharType>
+	constexpr uint64 HashName(const CharType* s, size_t length) noexcept {
+		uint64 hash = FNV1aOffsetBasis;
+
+		if constexpr (sizeof(CharType) == sizeof(char32))
+		{
+			for (size_t i = 0; i < length; ++i)
+			{ hash = HashCodePoint(hash, static_cast<char32>(s[i])); }
+
+			return hash;
+		}
+
+		for (size_t i = 0; i < length;)
+		{
+			const auto lead = static_cast<uint8>(s[i]);
+
+			const size_t count = (lead < 0x80) ? 1 : (lead < 0xE0) ? 2 : (lead < 0xF0) ? 3 : 4;
+
+			char32 ch = (count == 1) ? lead : (lead & (0x7F >> count));
+
+			for (size_t k = 1; k < count && (i + k) < length; ++k)
+			{ ch = ((ch << 6) | (static_cast<uint8>(s[i + k]) & 0x3F)); }
+
+			hash = HashCodePoint(hash, ch);
+
+			i += count;
+		}
+
+		return hash;
+	}
+
+#if TOMOLATOON_ASSET_ID_NAMES
+
+	// ID から名前への表
+	struct AssetIDNames
+	{
+		// 別の名前が同じ ID になったら例外を投げる
+		static void Register(uint64 id, StringView name) {
+			auto& instance = Get();
+
+			std::lock_guard lock{instance.mutex};
+
+			if (auto [it, inserted] = instance.names.try_emplace(id, name); not inserted && it->second != name)
+			{ throw Error(U"[AssetID]: `{}` and `{}` have the same ID"_fmt(it->second, name)); }
+		}
+
+		static Optional<String> Find(uint64 id) {
+			auto& instance = Get();
+
+			std::lock_guard lock{instance.mutex};
+
+			if (auto it = instance.names.find(id); it != instance.names.end())
+			{ return it->second; }
+
+			return none;
+		}
+
+	private:
+
+		static AssetIDNames& Get() {
+			static AssetIDNames instance;
+
+			return instance;
+		}
+
+		std::mutex mutex;
+
+		HashTable<uint64, String> names;
+	};
+
+	template <AssetIDLiteral Name>
+	struct AssetIDLiteralName
+	{
+		static bool Register() {
+			if constexpr (sizeof(Name.chars[0]) == sizeof(char32))
+			{ AssetIDNames::Register(HashName(Name.chars, Name.Length), StringView{Name.chars, Name.Length}); }
+			else
+			{
+				const std::string_view utf8{reinterpret_cast<const char*>(Name.chars), Name.Length};
+				AssetIDNames::Register(HashName(Name.chars, Name.Length), Unicode::FromUTF8(utf8));
+			}
+
+			return true;
+		}
+
+		inline static const bool Registered = Register();
+	};
+
+#endif
+} // namespace tomolatoon::detail
+
+namespace tomolatoon
+{
+	/// @brief 名前のハッシュ値（64 ビットの FNV-1a）で表すアセットの ID
+	/// @details
+	/// 名前は UTF-32 の符号位置でハッシュするので、リテラル（"player/idle"_aid）から作っても、
+	/// 実行時に String から作っても同じ ID になる。リテラルから作る場合は、ハッシュ値はコンパイル時に求まる。
+	/// TOMOLATOON_ASSET_ID_NAMES が 1 の場合（既定ではデバッグビルド）は、ID から名前を引ける。
+	struct AssetID
+	{
+		constexpr AssetID() = default;
+
+		constexpr explicit AssetID(uint64 value) noexcept
+			: m_value(value) {}
+
+		/// @brief 名前から ID を作る。名前のハッシュは 1 度だけ計算する
+		AssetID(StringView name)
+			: m_value(Hash(name)) {
+#if TOMOLATOON_ASSET_ID_NAMES
+			detail::AssetIDNames::Register(m_value, name);
+#endif
+		}
+
+		AssetID(const String& name)
+			: AssetID(StringView{name}) {}
+
+		AssetID(const char32* name)
+			: AssetID(StringView{name}) {}
+
+		constexpr uint64 value() const noexcept {
+			return m_value;
+		}
+
+		/// @brief 名前のハッシュ値
+		static constexpr uint64 Hash(StringView name) noexcept {
+			return detail::HashName(name.data(), name.size());
+		}
+
+		/// @brief ID の元の名前
+		/// @return 名前が分からない（TOMOLATOON_ASSET_ID_NAMES が 0 の）場合は none
+		static Optional<String> GetName([[maybe_unused]] AssetID id) {
+#if TOMOLATOON_ASSET_ID_NAMES
+			return detail::AssetIDNames::Find(id.m_value);
+#else
+			return none;
+#endif
+		}
+
+		friend constexpr bool operator==(const AssetID&, const AssetID&) noexcept = default;
+
+		friend constexpr auto operator<=>(const AssetID&, const AssetID&) noexcept = default;
+
+		/// @brief 名前が分かればその名前を、分からなければ ID を 16 進数で書き出す
+		friend void Formatter(FormatData& formatData, const AssetID& id) {
+			if (const auto name = GetName(id))
+			{ formatData.string.append(*name); }
+			else
+			{ formatData.string.append(U"#{:016X}"_fmt(id.m_value)); }
+		}
+
+	private:
+
+		uint64 m_value = 0;
+	};
+
+	inline namespace literals
+	{
+		/// @brief コンパイル時に名前をハッシュした AssetID を作る
+		template <detail::AssetIDLiteral Name>
+		constexpr AssetID operator""_aid() noexcept {
+#if TOMOLATOON_ASSET_ID_NAMES
+			// 使われたリテラルの名前は、プログラムの開始時に登録される
+			if (not std::is_constant_evaluated())
+			{ static_cast<void>(detail::AssetIDLiteralName<Name>::Registered); }
+#endif
+
+			return AssetID{detail::HashName(Name.chars, Name.Length)};
+		}
+	} // namespace literals
+} // namespace tomolatoon
+
+template <>
+struct std::hash<tomolatoon::AssetID>
+{
+	size_t operator()(const tomolatoon::AssetID& id) const noexcept {
+		return static_cast<size_t>(id.value());
+	}
+};
@@ -0,0 +1,256 @@
+﻿#pragma once
+#include <array>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <memory>
+#include <new>
+#include <utility>
+#include <Siv3D.hpp>
+
+namespace tomolatoon::detail
+{
+	// 要素のアドレスが変わらない可変長配列
+	// k 番目のブロックに Base * 2^k 個の要素を入れるので、ブロックの表は固定長で済み、再確保されない
+	template <class T, size_t Base = 64>
+	struct BlockArray
+	{
+		BlockArray() = default;
+
+		BlockArray(const BlockArray&) = delete;
+
+		BlockArray& operator=(const BlockArray&) = delete;
+
+		~BlockArray() {
+			clear();
+
+			for (size_t k = 0; k < m_blocks.size(); ++k)
+			{
+				if (m_blocks[k])
+				{ ::operator delete(m_blocks[k], (BlockSize(k) * sizeof(T)), std::align_val_t{alignof(T)}); }
+			}
+		}
+
+		T& operator[](size_t i) noexcept {
+			const auto [k, offset] = Locate(i);
+
+			return m_blocks[k][offset];
+		}
+
+		const T& operator[](size_t i) const noexcept {
+			const auto [k, offset] = Locate(i);
+
+			return m_blocks[k][offset];
+		}
+
+		template <class... Args>
+		T& emplace_back(Args&&... args) {
+			const auto [k, offset] = Locate(m_size);
+
+			if (m_blocks[k] == nullptr)
+			{
+				m_blocks[k] = static_cast<T*>(
+					::operator new((BlockSize(k) * sizeof(T)), std::align_val_t{alignof(T)})
+				);
+			}
+
+			T& result = *std::construct_at((m_blocks[k] + offset), std::forward<Args>(args)...);
+
+			++m_size;
+
+			return result;
+		}
+
+		void pop_back() noexcept {
+			--m_size;
+			std::destroy_at(&(*this)[m_size]);
+		}
+
+		T& back() noexcept {
+			return (*this)[m_size - 1];
+		}
+
+		size_t size() const noexcept {
+			return m_size;
+		}
+
+		// 要素を破棄するが、ブロックは再利用のために残す
+		void clear() noexcept {
+			while (m_size)
+			{ pop_back(); }
+		}
+
+	private:
+
+		static constexpr size_t BlockSize(size_t k) noexcept {
+			return (Base << k);
+		}
+
+		static constexpr std::pair<size_t, size_t> Locate(size_t i) noexcept {
+			const size_t k = (std::bit_width((i / Base) + 1) - 1);
+
+			return {k, (i - (Base * ((size_t{1} << k) - 1)))};
+		}
+
+		std::array<T*, (std::numeric_limits<size_t>::digits - std::bit_width(Base))> m_blocks{};
+
+		size_t m_size = 0;
+	};
+} // namespace tomolatoon::detail
+
+namespace tomolatoon
+{
+	/// @brief SlotMap の要素を指すキー
+	struct SlotMapKey
+	{
+		static constexpr uint32 InvalidIndex = std::numeric_limits<uint32>::max();
+
+		uint32 index = InvalidIndex;
+
+		uint32 generation = 0;
+
+		constexpr bool isValid() const noexcept {
+			return (index != InvalidIndex);
+		}
+
+		friend constexpr bool operator==(const SlotMapKey&, const SlotMapKey&) noexcept = default;
+	};
+
+	/// @brief 値へのポインタを密な配列に持ち、世代付きのキーで参照するコンテナ
+	/// @details
+	/// キーは、値の位置を指すスロットの番号と、そのスロットの世代からなる。
+	/// 値を削除するとスロットの世代が進み、古いキーは無効になる。空いたスロットは再利用される。
+	/// ポインタは常に隙間なく並ぶので（削除時は末尾のポインタで穴を埋める）、全要素を順に辿るのが速い。
+	/// 値そのものは個別に確保して動かさないので、値を指す参照は、その値を削除するまで有効。
+	/// @note 参照を取り出す操作と挿入・削除が別のスレッドで同時に起きないよう、呼び出し側で排他すること
+	template <class T>
+	struct SlotMap
+	{
+		SlotMap() = default;
+
+		SlotMap(const SlotMap&) = delete;
+
+		SlotMap& operator=(const SlotMap&) = delete;
+
+		template <class... Args>
+		SlotMapKey emplace(Args&&... args) {
+			uint32 index;
+
+			if (m_freeHead != SlotMapKey::InvalidIndex)
+			{
+				index      = m_freeHead;
+				m_freeHead = m_slots[index].position;
+			}
+			else
+			{
+				index = static_cast<uint32>(m_slots.size());
+				m_slots.emplace_back();
+				m_slotCount.store(m_slots.size(), std::memory_order_release);
+			}
+
+			m_values.emplace_back(std::make_unique<T>(std::forward<Args>(args)...));
+			m_owners.emplace_back(index);
+
+			Slot& slot    = m_slots[index];
+			slot.position = static_cast<uint32>(m_values.size() - 1);
+
+			return SlotMapKey{index, slot.generation.load(std::memory_order_relaxed)};
+		}
+
+		/// @return 削除したら true
+		bool erase(SlotMapKey key) {
+			if (not contains(key))
+			{ return false; }
+
+			Slot& slot = m_slots[key.index];
+
+			const uint32 last = static_cast<uint32>(m_values.size() - 1);
+
+			// 動かすのはポインタだけで、値は動かさない
+			if (slot.position != last)
+			{
+				m_values[slot.position] = std::move(m_values[last]);
+				m_owners[slot.position] = m_owners[last];
+
+				m_slots[m_owners[slot.position]].position = slot.position;
+			}
+
+			m_values.pop_back();
+			m_owners.pop_back();
+
+			slot.generation.fetch_add(1, std::memory_order_release);
+			slot.position = m_freeHead;
+			m_freeHead    = key.index;
+
+			return true;
+		}
+
+		bool contains(SlotMapKey key) const noexcept {
+			return (key.index < m_slotCount.load(std::memory_order_acquire)
+			        && m_slots[key.index].generation.load(std::memory_order_acquire) == key.generation);
+		}
+
+		/// @return key が無効なら nullptr
+		T* find(SlotMapKey key) noexcept {
+			return (contains(key) ? m_values[m_slots[key.index].position].get() : nullptr);
+		}
+
+		const T* find(SlotMapKey key) const noexcept {
+			return (contains(key) ? m_values[m_slots[key.index].position].get() : nullptr);
+		}
+
+		/// @brief 要素を密に並んだ順に f(キー, 値) で辿る
+		template <class F>
+		void forEach(F&& f) {
+			for (size_t i = 0; i < m_values.size(); ++i)
+			{ f(keyAt(i), *m_values[i]); }
+		}
+
+		template <class F>
+		void forEach(F&& f) const {
+			for (size_t i = 0; i < m_values.size(); ++i)
+			{ f(keyAt(i), std::as_const(*m_values[i])); }
+		}
+
+		size_t size() const noexcept {
+			return m_values.size();
+		}
+
+		bool isEmpty() const noexcept {
+			return (m_values.size() == 0);
+		}
+
+		/// @brief 全ての要素を削除する。それまでのキーは全て無効になる
+		void clear() {
+			while (not isEmpty())
+			{ erase(keyAt(m_values.size() - 1)); }
+		}
+
+	private:
+
+		struct Slot
+		{
+			std::atomic<uint32> generation = 0;
+
+			// 使用中なら値の位置、空いていれば次の空きスロットの番号
+			uint32 position = SlotMapKey::InvalidIndex;
+		};
+
+		SlotMapKey keyAt(size_t position) const noexcept {
+			const uint32 index = m_owners[position];
+
+			return SlotMapKey{index, m_slots[index].generation.load(std::memory_order_relaxed)};
+		}
+
+		detail::BlockArray<Slot> m_slots;
+
+		std::atomic<size_t> m_slotCount = 0;
+
+		detail::BlockArray<std::unique_ptr<T>> m_values;
+
+		// 値の位置からスロットの番号への対応
+		detail::BlockArray<uint32> m_owners;
+
+		uint32 m_freeHead = SlotMapKey::InvalidIndex;
+	};
+} // namespace tomolatoon
@@ -0,0 +1,171 @@
+﻿#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <Siv3D.hpp>
+
+namespace tomolatoon
+{
+	/// @brief アセットの構築をバックグラウンドで行うスレッドプール
+	/// @details
+	/// 投入された仕事を、投入された順に空いているスレッドで実行する。
+	/// 仕事の中で他の仕事の完了を待つ時は Wait を使う。待つ間にまだ始まっていない仕事を実行するので、
+	/// 待ち合わせの深さがスレッド数を超えても止まらない。
+	/// @note 破棄時には、まだ始まっていない仕事を捨て、実行中の仕事の終了を待つ
+	struct AssetWorkerPool
+	{
+		/// @param threadCount スレッド数（1 以上）
+		explicit AssetWorkerPool(size_t threadCount = DefaultThreadCount()) {
+			for (size_t i = 0; i < Max<size_t>(threadCount, 1); ++i)
+			{ m_threads.emplace_back([this] { run(); }); }
+		}
+
+		AssetWorkerPool(const AssetWorkerPool&) = delete;
+
+		AssetWorkerPool& operator=(const AssetWorkerPool&) = delete;
+
+		~AssetWorkerPool() {
+			{
+				std::lock_guard lock{m_mutex};
+
+				m_stopping = true;
+				m_tasks.clear();
+			}
+
+			m_condition.notify_all();
+
+			for (auto& thread : m_threads)
+			{ thread.join(); }
+		}
+
+		/// @brief 仕事を投入する
+		/// @note task が投げた例外は捨てられるので、task の中で処理すること
+		void submit(std::function<void()> task) {
+			{
+				std::lock_guard lock{m_mutex};
+
+				m_tasks.push_back(std::move(task));
+			}
+
+			m_condition.notify_one();
+		}
+
+		/// @brief スレッド数
+		size_t threadCount() const noexcept {
+			return m_threads.size();
+		}
+
+		/// @brief まだ始まっていない仕事の数
+		size_t pendingCount() const {
+			std::lock_guard lock{m_mutex};
+
+			return m_tasks.size();
+		}
+
+		/// @brief 呼び出したスレッドがこのプールのスレッドかどうか
+		bool isWorkerThread() const noexcept {
+			return (m_current == this);
+		}
+
+		/// @brief 呼び出したスレッドが属するプール。プールのスレッドでなければ nullptr
+		static AssetWorkerPool* Current() noexcept {
+			return m_current;
+		}
+
+		/// @brief future が完了するまで待つ
+		/// @details プールのスレッドから呼ばれたら、待つ間にそのプールのまだ始まっていない仕事を実行する
+		template <class Future>
+		static void Wait(const Future& future) {
+			AssetWorkerPool* pool = m_current;
+
+			if (pool == nullptr)
+			{
+				future.wait();
+				return;
+			}
+
+			while (future.wait_for(std::chrono::seconds{0}) != std::future_status::ready)
+			{ pool->runPending(); }
+		}
+
+		/// @brief メインスレッドの分を除いた、論理コア数
+		static size_t DefaultThreadCount() noexcept {
+			return (Max<size_t>(std::thread::hardware_concurrency(), 2) - 1);
+		}
+
+		/// @brief Asset::LoadAsync が既定で使うスレッドプール
+		static AssetWorkerPool& Default() {
+			static AssetWorkerPool pool;
+
+			return pool;
+		}
+
+	private:
+
+		void run() {
+			m_current = this;
+
+			for (;;)
+			{
+				std::function<void()> task;
+
+				{
+					std::unique_lock lock{m_mutex};
+
+					m_condition.wait(lock, [this] { return (m_stopping || not m_tasks.empty()); });
+
+					if (m_stopping)
+					{ return; }
+
+					task = std::move(m_tasks.front());
+					m_tasks.pop_front();
+				}
+
+				Execute(task);
+			}
+		}
+
+		// まだ始まっていない仕事があれば 1 つ実行する
+		// 待っている仕事が他のスレッドで終わっても知らせは来ないので、仕事が無ければ少しだけ待って戻る
+		void runPending() {
+			std::function<void()> task;
+
+			{
+				std::unique_lock lock{m_mutex};
+
+				if (not m_condition.wait_for(lock, std::chrono::milliseconds{1}, [this] {
+						return (m_stopping || not m_tasks.empty());
+					})
+				    || m_stopping)
+				{ return; }
+
+				task = std::move(m_tasks.front());
+				m_tasks.pop_front();
+			}
+
+			Execute(task);
+		}
+
+		static void Execute(const std::function<void()>& task) {
+			try
+			{ task(); }
+			catch (...)
+			{}
+		}
+
+		inline static thread_local AssetWorkerPool* m_current = nullptr;
+
+		mutable std::mutex m_mutex;
+
+		std::condition_variable m_condition;
+
+		std::deque<std::function<void()>> m_tasks;
+
+		bool m_stopping = false;
+
+		Array<std::thread> m_threads;
+	};
+} // namespace tomolatoon
@@ -0,0 +1,181 @@
+﻿module;
+#include <list>
+#include <memory>
+#include <Siv3D.hpp>
+
+export module tomolatoon.BudouX.cache;
+import tomolatoon.BudouX;
+
+export namespace tomolatoon
+{
+	/// @brief BudouXParser の解析結果を文字列ごとに記憶しておくキャッシュ
+	/// @details
+	/// 毎フレーム同じ文字列を解析するような、即時モードの UI 向け。
+	/// 文字列の 64bit ハッシュと長さをキーにし、合計サイズが予算を超えたら最も長く使われていないものから捨てる。
+	/// @note 渡したパーサーはキャッシュより長く生存している必要がある
+	struct BudouXCache
+	{
+		/// @brief 共有される、変更不可の境界の配列
+		using Boundaries = std::shared_ptr<const Array<size_t>>;
+
+		/// @brief コンストラクタ
+		/// @param parser 解析に用いるパーサー
+		/// @param byteBudget キャッシュが保持する文字列と境界の合計サイズの上限（バイト）
+		BudouXCache(const BudouXParser& parser, size_t byteBudget = (4 * 1024 * 1024))
+			: m_parser{std::addressof(parser)}, m_byteBudget{byteBudget} {}
+
+		/// @brief BudouXParser::parseBoundaries と同じ結果を、キャッシュがあればそこから返す
+		Boundaries parseBoundaries(StringView sentence) {
+			const uint64 hash = sentence.hash();
+
+			if (const auto it = m_index.find(hash); it != m_index.end())
+			{
+				const auto entry = it->second;
+
+				if (entry->text.size() == sentence.size() && entry->text == sentence)
+				{
+					++m_hits;
+
+					m_entries.splice(m_entries.begin(), m_entries, entry);
+
+					return entry->boundaries;
+				}
+
+				// ハッシュが衝突した場合は古い方を捨てる
+				erase(entry);
+			}
+
+			++m_misses;
+
+			auto boundaries =
+				std::make_shared<const Array<size_t>>(m_parser->parseBoundaries(sentence));
+
+			const size_t bytes = EntryBytes(sentence, *boundaries);
+
+			if (bytes <= m_byteBudget)
+			{
+				m_entries.push_front(Entry{
+					.text       = String{sentence},
+					.hash       = hash,
+					.boundaries = boundaries,
+					.bytes      = bytes,
+				});
+				m_index.emplace(hash, m_entries.begin());
+				m_bytes += bytes;
+
+				shrink();
+			}
+
+			return boundaries;
+		}
+
+		/// @brief BudouXParser::parseView と同じ結果を、キャッシュされた境界から作って返す
+		Array<StringView> parseView(StringView sentence) {
+			const auto boundaries = parseBoundaries(sentence);
+
+			Array<StringView> result;
+			result.reserve(boundaries->size() + 1);
+
+			size_t start = 0;
+
+			for (size_t boundary : *boundaries)
+			{
+				result.push_back(sentence.substr(start, (boundary - start)));
+
+				start = boundary;
+			}
+
+			result.push_back(sentence.substr(start));
+
+			return result;
+		}
+
+		/// @brief キャッシュが使われた回数
+		size_t hits() const noexcept {
+			return m_hits;
+		}
+
+		/// @brief キャッシュが使われず、解析を行った回数
+		size_t misses() const noexcept {
+			return m_misses;
+		}
+
+		void resetCounters() noexcept {
+			m_hits   = 0;
+			m_misses = 0;
+		}
+
+		/// @brief 現在保持しているエントリの数
+		size_t size() const noexcept {
+			return m_entries.size();
+		}
+
+		/// @brief 現在保持しているエントリの合計サイズ（バイト）
+		size_t bytes() const noexcept {
+			return m_bytes;
+		}
+
+		size_t byteBudget() const noexcept {
+			return m_byteBudget;
+		}
+
+		void setByteBudget(size_t byteBudget) {
+			m_byteBudget = byteBudget;
+
+			shrink();
+		}
+
+		void clear() {
+			m_entries.clear();
+			m_index.clear();
+			m_bytes = 0;
+		}
+
+		const BudouXParser& getPerserRef() const noexcept {
+			return *m_parser;
+		}
+
+	private:
+
+		struct Entry
+		{
+			String text;
+
+			uint64 hash = 0;
+
+			Boundaries boundaries;
+
+			size_t bytes = 0;
+		};
+
+		static size_t EntryBytes(StringView sentence, const Array<size_t>& boundaries) noexcept {
+			return sizeof(Entry) + sentence.size_bytes() + (boundaries.size() * sizeof(size_t));
+		}
+
+		void erase(std::list<Entry>::iterator entry) {
+			m_bytes -= entry->bytes;
+			m_index.erase(entry->hash);
+			m_entries.erase(entry);
+		}
+
+		void shrink() {
+			while (m_byteBudget < m_bytes)
+			{ erase(std::prev(m_entries.end())); }
+		}
+
+		const BudouXParser* m_parser = nullptr;
+
+		size_t m_byteBudget = 0;
+
+		size_t m_bytes = 0;
+
+		size_t m_hits = 0;
+
+		size_t m_misses = 0;
+
+		// 先頭ほど最近使われたもの
+		std::list<Entry> m_entries;
+
+		HashTable<uint64, std::list<Entry>::iterator> m_index;
+	};
+} // namespace tomolatoon
@@ -0,0 +1,188 @@
+﻿module;
+#include <array>
+#include <Siv3D.hpp>
+
+export module tomolatoon.BudouX.glyph_cache;
+
+namespace tomolatoon::detail
+{
+	constexpr bool IsRegionalIndicator(char32 ch) noexcept {
+		return (U'\U0001F1E6' <= ch && ch <= U'\U0001F1FF');
+	}
+
+	// 直前の文字と同じクラスタに続く文字（結合文字、異体字セレクタ、ZWJ、絵文字の修飾子・タグ）なら true
+	constexpr bool IsGraphemeExtend(char32 ch) noexcept {
+		return ((U'\u0300' <= ch && ch <= U'\u036F')              // 結合分音記号
+		        || (U'\u1160' <= ch && ch <= U'\u11FF')           // ハングルの中声・終声
+		        || (U'\u1AB0' <= ch && ch <= U'\u1AFF')           // 結合分音記号拡張
+		        || (U'\u1DC0' <= ch && ch <= U'\u1DFF')           // 結合分音記号補助
+		        || (ch == U'\u200D')                              // ZWJ
+		        || (U'\u20D0' <= ch && ch <= U'\u20FF')           // 記号用結合分音記号
+		        || (U'\u3099' <= ch && ch <= U'\u309A')           // 結合用の濁点・半濁点
+		        || (U'\uFE00' <= ch && ch <= U'\uFE0F')           // 異体字セレクタ
+		        || (U'\uFE20' <= ch && ch <= U'\uFE2F')           // 結合半記号
+		        || (U'\U0001F3FB' <= ch && ch <= U'\U0001F3FF')   // 絵文字の肌の色
+		        || (U'\U000E0020' <= ch && ch <= U'\U000E007F')   // タグ
+		        || (U'\U000E0100' <= ch && ch <= U'\U000E01EF')); // 異体字セレクタ補助
+	}
+
+	// 文字を先頭から順に与え、直前の文字と同じクラスタに続くかどうかを判定する
+	struct GraphemeClusterScanner
+	{
+		bool continues(char32 ch) noexcept {
+			const bool regional = IsRegionalIndicator(ch);
+
+			// 国旗は 2 つの地域指示子で 1 つのクラスタになる
+			const bool pairsRegional = (regional && m_openRegional);
+
+			const bool result = (m_started && (m_afterZWJ || pairsRegional || IsGraphemeExtend(ch)));
+
+			m_started      = true;
+			m_afterZWJ     = (ch == U'\u200D');
+			m_openRegional = (regional && not pairsRegional);
+
+			return result;
+		}
+
+	private:
+
+		bool m_started = false;
+
+		bool m_afterZWJ = false;
+
+		bool m_openRegional = false;
+	};
+} // namespace tomolatoon::detail
+
+export namespace tomolatoon
+{
+	/// @brief フォントごとに、文字の送り幅をキャッシュするクラス
+	/// @details
+	/// 送り幅は (フォント ID, 文字) をキーに、フォントの基本サイズでの値を保存し、取得時にフォントサイズに合わせて拡大縮小する。
+	/// ASCII の範囲は配列で、それ以外の文字はフォントごとのハッシュテーブルで引く。
+	///
+	/// 複数の文字からなるクラスタ（結合文字、異体字セレクタ、ZWJ でつないだ絵文字、国旗など）は、
+	/// 先頭の文字の送り幅をクラスタ全体の送り幅とし、残りの文字を 0 とする。
+	/// @note 文字単位の送り幅なので、合字や、文脈で字形が変わる文字（アラビア文字など）のシェーピングは考慮されない。
+	/// そのような文字を含むテキストには FontAdvanceProvider を使うこと。スレッドセーフではない
+	struct GlyphAdvanceCache
+	{
+		/// @brief 1 文字の送り幅
+		double advance(const Font& font, char32 ch, double fontSize) {
+			auto& entry = fontEntry(font);
+
+			return (get(font, entry, ch) * (fontSize / entry.baseSize));
+		}
+
+		/// @brief text の各文字の送り幅
+		/// @note GlyphAdvanceProvider と同じ形式の結果を返す（クラスタの先頭以外の文字は 0）
+		Array<double> advances(const Font& font, StringView text, double fontSize) {
+			auto& entry = fontEntry(font);
+
+			const double scale = (fontSize / entry.baseSize);
+
+			Array<double> result(text.size(), 0.0);
+
+			detail::GraphemeClusterScanner scanner;
+
+			for (size_t i = 0; i < text.size(); ++i)
+			{
+				if (not scanner.continues(text[i]))
+				{ result[i] = (get(font, entry, text[i]) * scale); }
+			}
+
+			return result;
+		}
+
+		/// @brief text 全体の幅
+		double width(const Font& font, StringView text, double fontSize) {
+			auto& entry = fontEntry(font);
+
+			double result = 0.0;
+
+			detail::GraphemeClusterScanner scanner;
+
+			for (const char32 ch : text)
+			{
+				if (not scanner.continues(ch))
+				{ result += get(font, entry, ch); }
+			}
+
+			return (result * (fontSize / entry.baseSize));
+		}
+
+		/// @brief font の送り幅を返す GlyphAdvanceProvider を作る
+		/// @note 返り値はこのキャッシュを参照するので、キャッシュより長く使わないこと
+		auto provider(const Font& font) {
+			return [this, font](StringView text, double fontSize) { return advances(font, text, fontSize); };
+		}
+
+		/// @brief キャッシュされている文字の数
+		size_t size() const noexcept {
+			size_t result = 0;
+
+			for (const auto& [id, entry] : m_fonts)
+			{ result += (entry.asciiCount + entry.others.size()); }
+
+			return result;
+		}
+
+		/// @brief font の送り幅を破棄する
+		void release(const Font& font) {
+			m_fonts.erase(font.id().value());
+		}
+
+		/// @brief 全ての送り幅を破棄する
+		void clear() {
+			m_fonts.clear();
+		}
+
+	private:
+
+		// 送り幅は負にならないので、未取得を負の値で表す
+		static constexpr double Unset = -1.0;
+
+		struct FontEntry
+		{
+			double baseSize = 0.0;
+
+			size_t asciiCount = 0;
+
+			std::array<double, 128> ascii;
+
+			HashTable<char32, double> others;
+		};
+
+		FontEntry& fontEntry(const Font& font) {
+			auto [it, inserted] = m_fonts.try_emplace(font.id().value());
+
+			if (inserted)
+			{
+				it->second.baseSize = font.fontSize();
+				it->second.ascii.fill(Unset);
+			}
+
+			return it->second;
+		}
+
+		static double get(const Font& font, FontEntry& entry, char32 ch) {
+			if (ch < entry.ascii.size())
+			{
+				if (auto& advance = entry.ascii[ch]; advance != Unset)
+				{ return advance; }
+				else
+				{
+					++entry.asciiCount;
+					return (advance = font.getGlyphInfo(ch).xAdvance);
+				}
+			}
+
+			if (auto it = entry.others.find(ch); it != entry.others.end())
+			{ return it->second; }
+
+			return entry.others.emplace(ch, font.getGlyphInfo(ch).xAdvance).first->second;
+		}
+
+		HashTable<uint64, FontEntry> m_fonts;
+	};
+} // namespace tomolatoon
@@ -0,0 +1,325 @@
+﻿module;
+#include <algorithm>
+#include <array>
+#include <span>
+#include <utility>
+#include <Siv3D.hpp>
+
+export module tomolatoon.BudouX.html;
+import tomolatoon.BudouX;
+
+namespace tomolatoon::detail
+{
+	// 前後のテキストの文脈を切る（行を分ける）要素
+	constexpr StringView HTMLBlockElements[] = {
+		U"address", U"article", U"aside", U"blockquote", U"br", U"dd", U"div", U"dl", U"dt",
+		U"figcaption", U"figure", U"footer", U"h1", U"h2", U"h3", U"h4", U"h5", U"h6", U"header",
+		U"hr", U"li", U"main", U"nav", U"ol", U"p", U"pre", U"section", U"table", U"td", U"th",
+		U"tr", U"ul",
+	};
+
+	// 中身がテキストではない要素
+	constexpr StringView HTMLRawTextElements[] = {U"script", U"style", U"textarea", U"title"};
+
+	constexpr char32 ToLowerASCII(char32 ch) noexcept {
+		return (U'A' <= ch && ch <= U'Z') ? (ch + (U'a' - U'A')) : ch;
+	}
+
+	constexpr bool IsAlphaASCII(char32 ch) noexcept {
+		return (U'a' <= ToLowerASCII(ch) && ToLowerASCII(ch) <= U'z');
+	}
+
+	constexpr bool IsHTMLSpace(char32 ch) noexcept {
+		return (ch == U' ' || ch == U'\t' || ch == U'\n' || ch == U'\r' || ch == U'\f');
+	}
+
+	// lower は小文字であること
+	constexpr bool EqualsIgnoreCaseASCII(StringView s, StringView lower) noexcept {
+		return std::ranges::equal(s, lower, [](char32 a, char32 b) { return ToLowerASCII(a) == b; });
+	}
+
+	constexpr bool ContainsElement(std::span<const StringView> elements, StringView name) noexcept {
+		return std::ranges::any_of(elements, [&](StringView e) { return EqualsIgnoreCaseASCII(name, e); });
+	}
+
+	// html[p] が '<' の時、タグ（コメント以外）の始まりなら true
+	constexpr bool IsHTMLTagStart(StringView html, size_t p) noexcept {
+		if (html.size() <= (p + 1))
+		{ return false; }
+
+		const char32 next = html[p + 1];
+
+		if (next == U'/')
+		{ return ((p + 2) < html.size() && IsAlphaASCII(html[p + 2])); }
+
+		return (IsAlphaASCII(next) || next == U'!' || next == U'?');
+	}
+
+	// '<' から始まるタグの終わり（'>' の次）を返す。属性値の中の '>' は無視する
+	constexpr size_t FindHTMLTagEnd(StringView html, size_t p) noexcept {
+		char32 quote = 0;
+
+		for (++p; p < html.size(); ++p)
+		{
+			const char32 ch = html[p];
+
+			if (quote)
+			{
+				if (ch == quote)
+				{ quote = 0; }
+			}
+			else if (ch == U'"' || ch == U'\'')
+			{ quote = ch; }
+			else if (ch == U'>')
+			{ return (p + 1); }
+		}
+
+		return html.size();
+	}
+
+	// タグ（'<' から '>' まで）の要素名
+	constexpr StringView HTMLTagName(StringView tag) noexcept {
+		const size_t begin = (2 <= tag.size() && tag[1] == U'/') ? 2 : 1;
+
+		size_t end = begin;
+
+		while (end < tag.size() && (IsAlphaASCII(tag[end]) || (U'0' <= tag[end] && tag[end] <= U'9')))
+		{ ++end; }
+
+		return tag.substr(begin, (end - begin));
+	}
+
+	// p 以降で、name の終了タグが始まる位置を返す
+	constexpr size_t FindHTMLRawTextEnd(StringView html, size_t p, StringView name) noexcept {
+		for (; (p + 2) < html.size(); ++p)
+		{
+			if (html[p] == U'<' && html[p + 1] == U'/'
+			    && std::ranges::equal(
+				    html.substr((p + 2), name.size()),
+				    name,
+				    [](char32 a, char32 b) { return ToLowerASCII(a) == ToLowerASCII(b); }
+			    ))
+			{ return p; }
+		}
+
+		return html.size();
+	}
+
+	// html[p] が '&' の時、文字参照を解釈して (文字, 終わりの位置) を返す
+	// 名前の分からない文字参照は U+FFFD の 1 文字として扱う
+	constexpr Optional<std::pair<char32, size_t>> ParseHTMLEntity(StringView html, size_t p) noexcept {
+		// 最も長い文字参照でも 32 文字に収まる
+		const size_t limit = Min(html.size(), (p + 32));
+
+		size_t end = (p + 1);
+
+		while (end < limit && html[end] != U';')
+		{
+			const char32 ch = html[end];
+
+			if (not (IsAlphaASCII(ch) || (U'0' <= ch && ch <= U'9') || ch == U'#'))
+			{ return none; }
+
+			++end;
+		}
+
+		if (end == limit || end == (p + 1))
+		{ return none; }
+
+		const StringView body = html.substr((p + 1), (end - p - 1));
+
+		if (body[0] == U'#')
+		{
+			const bool   hex   = (2 <= body.size() && ToLowerASCII(body[1]) == U'x');
+			const size_t first = (hex ? 2 : 1);
+
+			uint32 value = 0;
+
+			for (size_t i = first; i < body.size(); ++i)
+			{
+				const char32 ch = ToLowerASCII(body[i]);
+
+				uint32 digit;
+
+				if (U'0' <= ch && ch <= U'9')
+				{ digit = (ch - U'0'); }
+				else if (hex && U'a' <= ch && ch <= U'f')
+				{ digit = (ch - U'a' + 10); }
+				else
+				{ return none; }
+
+				value = Min<uint32>(((value * (hex ? 16 : 10)) + digit), 0x110000);
+			}
+
+			if (first == body.size() || 0x10FFFF < value || (0xD800 <= value && value <= 0xDFFF))
+			{ return std::pair{U'\uFFFD', (end + 1)}; }
+
+			return std::pair{static_cast<char32>(value), (end + 1)};
+		}
+
+		constexpr std::pair<StringView, char32> Named[] = {
+			{U"amp", U'&'},
+			{U"lt", U'<'},
+			{U"gt", U'>'},
+			{U"quot", U'"'},
+			{U"apos", U'\''},
+			{U"nbsp", U'\u00A0'},
+		};
+
+		for (const auto& [name, ch] : Named)
+		{
+			if (body == name)
+			{ return std::pair{ch, (end + 1)}; }
+		}
+
+		return std::pair{U'\uFFFD', (end + 1)};
+	}
+} // namespace tomolatoon::detail
+
+export namespace tomolatoon
+{
+	/// @brief HTML のテキスト部分を BudouX で分割し、境界ごとに callback(位置) を呼ぶ
+	/// @details
+	/// 先頭から 1 回走査するだけで、タグやコメントは飛ばし、文字参照は 1 文字として扱う。
+	/// 直近 6 文字だけを保持するので、<b> などのインライン要素をまたいでも前後 3 文字の文脈が保たれる。
+	/// ブロック要素（p, div, br など）では文脈を切り、script や style などの中身は分割しない。
+	/// @param callback 境界の直後の文字（文字参照ならその '&'）の html 上の位置を受け取る関数
+	template <class Callback>
+	void ForEachHTMLBoundary(const BudouXParser& parser, StringView html, Callback&& callback) {
+		// 直近の最大 6 文字と、その html 上の位置
+		std::array<char32, 6> window;
+		std::array<size_t, 6> positions;
+
+		size_t size = 0;
+
+		// 今の文脈で読んだ文字の数
+		size_t count = 0;
+
+		const auto score = [&](size_t target) {
+			if (parser.parseCharacter(StringView{window.data(), size}, target))
+			{ callback(positions[target]); }
+		};
+
+		// 後ろ 2 文字が揃った位置から順に判定する
+		const auto push = [&](char32 ch, size_t position) {
+			if (size == window.size())
+			{
+				std::shift_left(window.begin(), window.end(), 1);
+				std::shift_left(positions.begin(), positions.end(), 1);
+				--size;
+			}
+
+			window[size]    = ch;
+			positions[size] = position;
+
+			++size;
+			++count;
+
+			if (4 <= count)
+			{ score(size - 3); }
+		};
+
+		const auto flush = [&] {
+			if (3 <= count)
+			{ score(size - 2); }
+
+			if (2 <= count)
+			{ score(size - 1); }
+
+			size  = 0;
+			count = 0;
+		};
+
+		for (size_t p = 0; p < html.size();)
+		{
+			const char32 ch = html[p];
+
+			if (ch == U'<')
+			{
+				if (html.substr(p).starts_with(U"<!--"))
+				{
+					p += 4;
+
+					while (p < html.size() && not html.substr(p).starts_with(U"-->"))
+					{ ++p; }
+
+					p = Min((p + 3), html.size());
+					continue;
+				}
+
+				if (detail::IsHTMLTagStart(html, p))
+				{
+					const size_t     end  = detail::FindHTMLTagEnd(html, p);
+					const StringView tag  = html.substr(p, (end - p));
+					const StringView name = detail::HTMLTagName(tag);
+
+					if (detail::ContainsElement(detail::HTMLBlockElements, name))
+					{ flush(); }
+
+					p = end;
+
+					if (tag[1] != U'/' && not tag.ends_with(U"/>")
+					    && detail::ContainsElement(detail::HTMLRawTextElements, name))
+					{
+						flush();
+						p = detail::FindHTMLRawTextEnd(html, p, name);
+					}
+
+					continue;
+				}
+			}
+			else if (ch == U'&')
+			{
+				if (const auto entity = detail::ParseHTMLEntity(html, p))
+				{
+					push(entity->first, p);
+					p = entity->second;
+					continue;
+				}
+			}
+
+			push((detail::IsHTMLSpace(ch) ? U' ' : ch), p);
+			++p;
+		}
+
+		flush();
+	}
+
+	/// @brief HTML のテキスト部分の境界の位置を返す
+	/// @see ForEachHTMLBoundary
+	inline Array<size_t> ParseHTMLBoundaries(const BudouXParser& parser, StringView html) {
+		Array<size_t> result;
+
+		ForEachHTMLBoundary(parser, html, [&](size_t position) { result.push_back(position); });
+
+		return result;
+	}
+
+	/// @brief HTML のテキスト部分の境界に separator を挿入する
+	/// @details 先に境界を求めて出力の長さを確定させてから、1 回の確保で書き出す
+	/// @param separator 挿入する文字列（<wbr> やゼロ幅スペースなど）
+	inline String InsertHTMLWordBreaks(
+		const BudouXParser& parser,
+		StringView          html,
+		StringView          separator = U"<wbr>"
+	) {
+		const Array<size_t> boundaries = ParseHTMLBoundaries(parser, html);
+
+		String result;
+		result.reserve(html.size() + (boundaries.size() * separator.size()));
+
+		size_t begin = 0;
+
+		for (const size_t boundary : boundaries)
+		{
+			result.append(html.substr(begin, (boundary - begin)));
+			result.append(separator);
+
+			begin = boundary;
+		}
+
+		result.append(html.substr(begin));
+
+		return result;
+	}
+} // namespace tomolatoon
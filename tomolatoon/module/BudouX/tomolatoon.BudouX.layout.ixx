@@ -0,0 +1,371 @@
+﻿module;
+#include <concepts>
+#include <deque>
+#include <functional>
+#include <span>
+#include <Siv3D.hpp>
+
+export module tomolatoon.BudouX.layout;
+
+namespace tomolatoon::detail
+{
+	// 行からはみ出した場合も、コストが行幅の凸関数のままになるように 2 乗に係数を掛ける
+	constexpr double OverflowPenalty = 1e6;
+
+	constexpr double LineCost(double width, double maxWidth) noexcept {
+		const double slack = (maxWidth - width);
+
+		return (0.0 <= slack) ? (slack * slack) : (slack * slack * OverflowPenalty);
+	}
+
+	// 最終行は余白を気にしない
+	constexpr double LastLineCost(double width, double maxWidth) noexcept {
+		const double slack = (maxWidth - width);
+
+		return (0.0 <= slack) ? 0.0 : (slack * slack * OverflowPenalty);
+	}
+} // namespace tomolatoon::detail
+
+export namespace tomolatoon
+{
+	/// @brief 各行の余白の 2 乗の和が最小になるように改行位置を決める
+	/// @details
+	/// 行のコストが行幅の凸関数なので、各位置の最適な直前の改行位置は単調に増える。
+	/// これを使い、候補を両端キューと二分探索で管理して O(n log n) で求める。
+	/// 最終行の余白はコストに含めない。
+	/// @param widths 改行できる位置で区切った各部分の幅（BudouX の文節の幅など）
+	/// @param maxWidth 1 行の最大幅
+	/// @return 行の先頭になる部分の番号（0 を除く、昇順）
+	/// @note 1 つで maxWidth を超える部分は、はみ出すコストが大きいので単独の行になる
+	inline Array<size_t> MinimumRaggednessBreaks(std::span<const double> widths, double maxWidth) {
+		const size_t n = widths.size();
+
+		if (n == 0)
+		{ return {}; }
+
+		Array<double> prefix(n + 1, 0.0);
+
+		for (size_t i = 0; i < n; ++i)
+		{ prefix[i + 1] = (prefix[i] + widths[i]); }
+
+		// best[i] は 部分 i の直前で改行する場合の、それまでの最小コスト
+		Array<double> best(n, 0.0);
+		Array<size_t> from(n, 0);
+
+		const auto cost = [&](size_t j, size_t i) {
+			return (best[j] + detail::LineCost((prefix[i] - prefix[j]), maxWidth));
+		};
+
+		struct Candidate
+		{
+			// 直前の改行位置
+			size_t j;
+
+			// j が最適になる最初の位置
+			size_t start;
+		};
+
+		std::deque<Candidate> queue{Candidate{0, 1}};
+
+		for (size_t i = 1; i < n; ++i)
+		{
+			while (2 <= queue.size() && queue[1].start <= i)
+			{ queue.pop_front(); }
+
+			best[i] = cost(queue.front().j, i);
+			from[i] = queue.front().j;
+
+			// i を候補に加える。i の方が良くなる位置以降は、i より前の候補が最適になることはない
+			size_t start = n;
+
+			while (i < queue.back().start
+			       && cost(i, queue.back().start) <= cost(queue.back().j, queue.back().start))
+			{
+				start = queue.back().start;
+				queue.pop_back();
+
+				if (queue.empty())
+				{ break; }
+			}
+
+			if (not queue.empty())
+			{
+				const size_t j = queue.back().j;
+
+				size_t low = Max(queue.back().start, (i + 1));
+
+				while (low < start)
+				{
+					const size_t middle = ((low + start) / 2);
+
+					if (cost(i, middle) <= cost(j, middle))
+					{ start = middle; }
+					else
+					{ low = (middle + 1); }
+				}
+			}
+
+			if (start < n)
+			{ queue.push_back(Candidate{i, start}); }
+		}
+
+		size_t last = 0;
+		double lastCost = detail::LastLineCost(prefix[n], maxWidth);
+
+		for (size_t j = 1; j < n; ++j)
+		{
+			if (const double c = (best[j] + detail::LastLineCost((prefix[n] - prefix[j]), maxWidth)); c < lastCost)
+			{
+				last     = j;
+				lastCost = c;
+			}
+		}
+
+		Array<size_t> result;
+
+		for (size_t j = last; j != 0; j = from[j])
+		{ result.push_back(j); }
+
+		result.reverse();
+
+		return result;
+	}
+
+	/// @brief 文字列の各文字の送り幅を返すもの
+	/// @details
+	/// provider(text, fontSize) は text.size() 個の送り幅を返す。
+	/// 複数の文字からなるクラスタでは、先頭の文字にクラスタ全体の送り幅を、残りの文字に 0 を入れる。
+	template <class T>
+	concept GlyphAdvanceProvider = requires (const T& provider, StringView text, double fontSize) {
+		{ provider(text, fontSize) } -> std::convertible_to<Array<double>>;
+	};
+
+	/// @brief Font から送り幅を取得する GlyphAdvanceProvider
+	struct FontAdvanceProvider
+	{
+		Font font;
+
+		Array<double> operator()(StringView text, double fontSize) const {
+			const auto drawable = font(text);
+			const auto advances = drawable.getXAdvances(fontSize);
+
+			Array<double> result(text.size(), 0.0);
+
+			for (size_t i = 0; i < drawable.clusters.size(); ++i)
+			{ result[drawable.clusters[i].pos] += advances[i]; }
+
+			return result;
+		}
+	};
+
+	/// @brief 文節の境界を使って、文節の途中でなるべく改行しないように行を組むクラス
+	/// @details
+	/// 1 つの文節が 1 行に収まらない場合は、クラスタ単位で分割する。
+	/// 改行位置は前から詰める（Greedy）か、MinimumRaggednessBreaks で行の長さを揃える（MinimumRaggedness）かを選べる。
+	/// 結果は (テキスト, 幅, フォントサイズ) をキーにキャッシュされ、いずれかが変わった時だけ計算し直す。
+	struct PhraseLayout
+	{
+		/// @brief 改行位置の決め方
+		enum class Wrapping : uint8
+		{
+			/// @brief 入るだけ前の行に詰める
+			Greedy,
+
+			/// @brief 各行の余白の 2 乗の和が最小になるようにする
+			MinimumRaggedness,
+		};
+
+		struct Line
+		{
+			/// @brief 行の開始位置（文字単位）
+			size_t begin = 0;
+
+			/// @brief 行の終了位置（文字単位、終端を含まない）
+			size_t end = 0;
+
+			/// @brief 行の幅
+			double width = 0.0;
+		};
+
+		template <GlyphAdvanceProvider Provider>
+		explicit PhraseLayout(Provider provider, Wrapping wrapping = Wrapping::Greedy)
+			: m_provider{std::move(provider)}
+			, m_wrapping{wrapping} {}
+
+		/// @brief 行を組む
+		/// @param text テキスト
+		/// @param boundaries text の文節の境界（BudouXParser::parseBoundaries の結果など）
+		/// @param maxWidth 1 行の最大幅
+		/// @param fontSize フォントサイズ
+		/// @param breakAtEveryBoundary 全ての境界で改行する場合は true
+		/// @note boundaries はキャッシュのキーに含まれないので、text が同じなら boundaries も同じであること
+		const Array<Line>& layout(
+			StringView              text,
+			std::span<const size_t> boundaries,
+			double                  maxWidth,
+			double                  fontSize,
+			bool                    breakAtEveryBoundary = false
+		) {
+			if (m_valid && m_maxWidth == maxWidth && m_fontSize == fontSize
+			    && m_breakAtEveryBoundary == breakAtEveryBoundary && m_text == text)
+			{ return m_lines; }
+
+			m_text                 = text;
+			m_maxWidth             = maxWidth;
+			m_fontSize             = fontSize;
+			m_breakAtEveryBoundary = breakAtEveryBoundary;
+			m_valid                = true;
+
+			relayout(boundaries);
+
+			return m_lines;
+		}
+
+		/// @brief 最後に組んだ行
+		const Array<Line>& lines() const noexcept {
+			return m_lines;
+		}
+
+		/// @brief 最後に組んだテキスト
+		const String& text() const noexcept {
+			return m_text;
+		}
+
+		/// @brief 改行位置の決め方
+		Wrapping wrapping() const noexcept {
+			return m_wrapping;
+		}
+
+		/// @brief 改行位置の決め方を変える
+		void setWrapping(Wrapping wrapping) noexcept {
+			if (m_wrapping != wrapping)
+			{
+				m_wrapping = wrapping;
+				m_valid    = false;
+			}
+		}
+
+		/// @brief キャッシュを破棄し、次の layout で必ず計算し直すようにする
+		void invalidate() noexcept {
+			m_valid = false;
+		}
+
+	private:
+
+		void relayout(std::span<const size_t> boundaries) {
+			m_lines.clear();
+
+			if (m_text.isEmpty())
+			{ return; }
+
+			const Array<double> advances = m_provider(m_text, m_fontSize);
+
+			if (m_wrapping == Wrapping::MinimumRaggedness && not m_breakAtEveryBoundary)
+			{ layoutMinimumRaggedness(boundaries, advances); }
+			else
+			{ layoutGreedy(boundaries, advances); }
+		}
+
+		void layoutGreedy(std::span<const size_t> boundaries, const Array<double>& advances) {
+			Line line;
+
+			const auto newLine = [&](size_t pos) {
+				line.end = pos;
+				m_lines.push_back(line);
+				line = Line{.begin = pos};
+			};
+
+			for (size_t i = 0; i <= boundaries.size(); ++i)
+			{
+				const size_t begin = (i == 0) ? 0 : boundaries[i - 1];
+				const size_t end   = (i < boundaries.size()) ? boundaries[i] : m_text.size();
+
+				double width = 0.0;
+
+				for (size_t k = begin; k < end; ++k)
+				{ width += advances[k]; }
+
+				if (line.begin != begin && (m_breakAtEveryBoundary || m_maxWidth < (line.width + width)))
+				{ newLine(begin); }
+
+				if ((line.width + width) <= m_maxWidth)
+				{
+					line.width += width;
+					continue;
+				}
+
+				// 1 行に収まらない文節はクラスタ単位で分割する
+				for (size_t k = begin; k < end; ++k)
+				{
+					if (line.begin != k && advances[k] != 0.0 && m_maxWidth < (line.width + advances[k]))
+					{ newLine(k); }
+
+					line.width += advances[k];
+				}
+			}
+
+			newLine(m_text.size());
+		}
+
+		void layoutMinimumRaggedness(std::span<const size_t> boundaries, const Array<double>& advances) {
+			// 改行できる位置で区切った部分。1 行に収まらない文節はクラスタ単位で行幅以下に分ける
+			Array<size_t> pieceBegins;
+			Array<double> pieceWidths;
+
+			for (size_t i = 0; i <= boundaries.size(); ++i)
+			{
+				const size_t begin = (i == 0) ? 0 : boundaries[i - 1];
+				const size_t end   = (i < boundaries.size()) ? boundaries[i] : m_text.size();
+
+				pieceBegins.push_back(begin);
+				pieceWidths.push_back(0.0);
+
+				for (size_t k = begin; k < end; ++k)
+				{
+					if (pieceBegins.back() != k && advances[k] != 0.0
+					    && m_maxWidth < (pieceWidths.back() + advances[k]))
+					{
+						pieceBegins.push_back(k);
+						pieceWidths.push_back(0.0);
+					}
+
+					pieceWidths.back() += advances[k];
+				}
+			}
+
+			const Array<size_t> breaks = MinimumRaggednessBreaks(pieceWidths, m_maxWidth);
+
+			for (size_t i = 0; i <= breaks.size(); ++i)
+			{
+				const size_t first = (i == 0) ? 0 : breaks[i - 1];
+				const size_t last  = (i < breaks.size()) ? breaks[i] : pieceBegins.size();
+
+				Line line{
+					.begin = pieceBegins[first],
+					.end   = (last < pieceBegins.size()) ? pieceBegins[last] : m_text.size(),
+				};
+
+				for (size_t k = first; k < last; ++k)
+				{ line.width += pieceWidths[k]; }
+
+				m_lines.push_back(line);
+			}
+		}
+
+		std::function<Array<double>(StringView, double)> m_provider;
+
+		String m_text;
+
+		double m_maxWidth = 0.0;
+
+		double m_fontSize = 0.0;
+
+		Wrapping m_wrapping = Wrapping::Greedy;
+
+		bool m_breakAtEveryBoundary = false;
+
+		bool m_valid = false;
+
+		Array<Line> m_lines;
+	};
+} // namespace tomolatoon
@@ -0,0 +1,365 @@
+﻿module;
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <Siv3D.hpp>
+
+export module tomolatoon.BudouX.line_break;
+import tomolatoon.BudouX;
+
+export namespace tomolatoon
+{
+	/// @brief UAX #14 の改行クラスのうち、日本語・中国語・タイ語と欧文の組版に必要なもの
+	/// @note PR, PO, CP などは近いクラスにまとめている（PR, PO は AL に、CP は CL に、IN と CJ は NS に）
+	enum class LineBreakClass : uint8
+	{
+		OP, // 開き括弧
+		CL, // 閉じ括弧、句読点
+		QU, // 引用符
+		GL, // ノーブレークスペースなど
+		NS, // 行頭禁則文字（小書きの仮名、長音記号など）
+		EX, // 感嘆符、疑問符
+		SY, // スラッシュ
+		IS, // 欧文の句読点
+		NU, // 数字
+		AL, // 英字など
+		ID, // 漢字、仮名、絵文字など（タイ文字もここに含める）
+		HY, // ハイフンマイナス
+		BA, // 後ろで改行できる文字（空白類、ハイフン）
+		ZW, // ゼロ幅スペース
+		CM, // 結合文字
+		WJ, // 単語結合子
+		SP, // スペース
+		BK, // 強制改行
+		CR,
+		LF,
+	};
+} // namespace tomolatoon
+
+namespace tomolatoon::detail
+{
+	enum class LineBreakAction : uint8
+	{
+		// 改行しない
+		Prohibited,
+
+		// 間にスペースがある時だけ改行できる
+		Indirect,
+
+		// 改行できる
+		Direct,
+	};
+
+	constexpr size_t LineBreakPairClasses = (static_cast<size_t>(LineBreakClass::WJ) + 1);
+
+	// UAX #14 のペアテーブル（行が前の文字、列が後ろの文字のクラス）
+	constexpr auto LineBreakPairTable = [] {
+		constexpr auto P = LineBreakAction::Prohibited;
+		constexpr auto I = LineBreakAction::Indirect;
+		constexpr auto D = LineBreakAction::Direct;
+
+		return std::array<std::array<LineBreakAction, LineBreakPairClasses>, LineBreakPairClasses>{{
+			// OP CL QU GL NS EX SY IS NU AL ID HY BA ZW CM WJ
+			{P, P, P, P, P, P, P, P, P, P, P, P, P, P, P, P}, // OP
+			{D, P, I, I, P, P, P, P, D, D, D, I, I, P, P, P}, // CL
+			{P, P, I, I, I, P, P, P, I, I, I, I, I, P, P, P}, // QU
+			{I, P, I, I, I, P, P, P, I, I, I, I, I, P, P, P}, // GL
+			{D, P, I, I, I, P, P, P, D, D, D, I, I, P, P, P}, // NS
+			{D, P, I, I, I, P, P, P, D, D, D, I, I, P, P, P}, // EX
+			{D, P, I, I, I, P, P, P, I, D, D, I, I, P, P, P}, // SY
+			{D, P, I, I, I, P, P, P, I, I, D, I, I, P, P, P}, // IS
+			{I, P, I, I, I, P, P, P, I, I, D, I, I, P, P, P}, // NU
+			{I, P, I, I, I, P, P, P, I, I, D, I, I, P, P, P}, // AL
+			{D, P, I, I, I, P, P, P, D, D, D, I, I, P, P, P}, // ID
+			{D, P, I, D, I, P, P, P, I, D, D, I, I, P, P, P}, // HY
+			{D, P, I, D, I, P, P, P, D, D, D, I, I, P, P, P}, // BA
+			{D, D, D, D, D, D, D, D, D, D, D, D, D, P, P, P}, // ZW
+			{I, P, I, I, I, P, P, P, I, I, D, I, I, P, P, P}, // CM
+			{I, P, I, I, I, P, P, P, I, I, I, I, I, P, P, P}, // WJ
+		}};
+	}();
+
+	constexpr auto LineBreakASCIITable = [] {
+		using enum LineBreakClass;
+
+		std::array<LineBreakClass, 128> table;
+
+		table.fill(AL);
+
+		for (size_t ch = 0; ch < 0x20; ++ch)
+		{ table[ch] = CM; }
+
+		table[0x7F] = CM;
+
+		table[U'\t'] = BA;
+		table[U'\n'] = LF;
+		table[U'\v'] = BK;
+		table[U'\f'] = BK;
+		table[U'\r'] = CR;
+		table[U' ']  = SP;
+		table[U'!']  = EX;
+		table[U'"']  = QU;
+		table[U'\''] = QU;
+		table[U'(']  = OP;
+		table[U')']  = CL;
+		table[U',']  = IS;
+		table[U'-']  = HY;
+		table[U'.']  = IS;
+		table[U'/']  = SY;
+		table[U':']  = IS;
+		table[U';']  = IS;
+		table[U'?']  = EX;
+		table[U'[']  = OP;
+		table[U']']  = CL;
+		table[U'{']  = OP;
+		table[U'}']  = CL;
+
+		for (char32 ch = U'0'; ch <= U'9'; ++ch)
+		{ table[ch] = NU; }
+
+		return table;
+	}();
+
+	struct LineBreakRange
+	{
+		char32 first;
+
+		char32 last;
+
+		LineBreakClass lineBreakClass;
+	};
+
+	// ASCII 以外の文字のクラス。first の昇順で、含まれない文字は AL
+	constexpr LineBreakRange LineBreakRanges[] = {
+		// clang-format off
+		{0x0085, 0x0085, LineBreakClass::BK}, {0x00A0, 0x00A0, LineBreakClass::GL},
+		{0x00AB, 0x00AB, LineBreakClass::QU}, {0x00AD, 0x00AD, LineBreakClass::BA},
+		{0x00BB, 0x00BB, LineBreakClass::QU}, {0x0300, 0x036F, LineBreakClass::CM},
+		{0x0E00, 0x0E30, LineBreakClass::ID}, {0x0E31, 0x0E31, LineBreakClass::CM},
+		{0x0E32, 0x0E33, LineBreakClass::ID}, {0x0E34, 0x0E3A, LineBreakClass::CM},
+		{0x0E3B, 0x0E46, LineBreakClass::ID}, {0x0E47, 0x0E4E, LineBreakClass::CM},
+		{0x0E4F, 0x0E7F, LineBreakClass::ID}, {0x2000, 0x2006, LineBreakClass::BA},
+		{0x2007, 0x2007, LineBreakClass::GL}, {0x2008, 0x200A, LineBreakClass::BA},
+		{0x200B, 0x200B, LineBreakClass::ZW}, {0x200C, 0x200D, LineBreakClass::CM},
+		{0x2010, 0x2010, LineBreakClass::BA}, {0x2011, 0x2011, LineBreakClass::GL},
+		{0x2012, 0x2013, LineBreakClass::BA}, {0x2018, 0x2019, LineBreakClass::QU},
+		{0x201C, 0x201D, LineBreakClass::QU}, {0x2024, 0x2026, LineBreakClass::NS},
+		{0x2028, 0x2029, LineBreakClass::BK}, {0x202F, 0x202F, LineBreakClass::GL},
+		{0x2039, 0x203A, LineBreakClass::QU}, {0x203C, 0x203D, LineBreakClass::NS},
+		{0x2047, 0x2049, LineBreakClass::NS}, {0x2060, 0x2060, LineBreakClass::WJ},
+		{0x2E80, 0x2FFF, LineBreakClass::ID}, {0x3000, 0x3000, LineBreakClass::BA},
+		{0x3001, 0x3002, LineBreakClass::CL}, {0x3003, 0x3004, LineBreakClass::ID},
+		{0x3005, 0x3005, LineBreakClass::NS}, {0x3006, 0x3007, LineBreakClass::ID},
+		{0x3008, 0x3008, LineBreakClass::OP}, {0x3009, 0x3009, LineBreakClass::CL},
+		{0x300A, 0x300A, LineBreakClass::OP}, {0x300B, 0x300B, LineBreakClass::CL},
+		{0x300C, 0x300C, LineBreakClass::OP}, {0x300D, 0x300D, LineBreakClass::CL},
+		{0x300E, 0x300E, LineBreakClass::OP}, {0x300F, 0x300F, LineBreakClass::CL},
+		{0x3010, 0x3010, LineBreakClass::OP}, {0x3011, 0x3011, LineBreakClass::CL},
+		{0x3012, 0x3013, LineBreakClass::ID}, {0x3014, 0x3014, LineBreakClass::OP},
+		{0x3015, 0x3015, LineBreakClass::CL}, {0x3016, 0x3016, LineBreakClass::OP},
+		{0x3017, 0x3017, LineBreakClass::CL}, {0x3018, 0x3018, LineBreakClass::OP},
+		{0x3019, 0x3019, LineBreakClass::CL}, {0x301A, 0x301A, LineBreakClass::OP},
+		{0x301B, 0x301B, LineBreakClass::CL}, {0x301C, 0x301C, LineBreakClass::NS},
+		{0x301D, 0x301D, LineBreakClass::OP}, {0x301E, 0x301F, LineBreakClass::CL},
+		{0x3020, 0x303A, LineBreakClass::ID}, {0x303B, 0x303B, LineBreakClass::NS},
+		{0x303C, 0x3040, LineBreakClass::ID}, {0x3041, 0x3041, LineBreakClass::NS},
+		{0x3042, 0x3042, LineBreakClass::ID}, {0x3043, 0x3043, LineBreakClass::NS},
+		{0x3044, 0x3044, LineBreakClass::ID}, {0x3045, 0x3045, LineBreakClass::NS},
+		{0x3046, 0x3046, LineBreakClass::ID}, {0x3047, 0x3047, LineBreakClass::NS},
+		{0x3048, 0x3048, LineBreakClass::ID}, {0x3049, 0x3049, LineBreakClass::NS},
+		{0x304A, 0x3062, LineBreakClass::ID}, {0x3063, 0x3063, LineBreakClass::NS},
+		{0x3064, 0x3082, LineBreakClass::ID}, {0x3083, 0x3083, LineBreakClass::NS},
+		{0x3084, 0x3084, LineBreakClass::ID}, {0x3085, 0x3085, LineBreakClass::NS},
+		{0x3086, 0x3086, LineBreakClass::ID}, {0x3087, 0x3087, LineBreakClass::NS},
+		{0x3088, 0x308D, LineBreakClass::ID}, {0x308E, 0x308E, LineBreakClass::NS},
+		{0x308F, 0x3094, LineBreakClass::ID}, {0x3095, 0x3096, LineBreakClass::NS},
+		{0x3097, 0x3098, LineBreakClass::ID}, {0x3099, 0x309A, LineBreakClass::CM},
+		{0x309B, 0x309E, LineBreakClass::NS}, {0x309F, 0x309F, LineBreakClass::ID},
+		{0x30A0, 0x30A1, LineBreakClass::NS}, {0x30A2, 0x30A2, LineBreakClass::ID},
+		{0x30A3, 0x30A3, LineBreakClass::NS}, {0x30A4, 0x30A4, LineBreakClass::ID},
+		{0x30A5, 0x30A5, LineBreakClass::NS}, {0x30A6, 0x30A6, LineBreakClass::ID},
+		{0x30A7, 0x30A7, LineBreakClass::NS}, {0x30A8, 0x30A8, LineBreakClass::ID},
+		{0x30A9, 0x30A9, LineBreakClass::NS}, {0x30AA, 0x30C2, LineBreakClass::ID},
+		{0x30C3, 0x30C3, LineBreakClass::NS}, {0x30C4, 0x30E2, LineBreakClass::ID},
+		{0x30E3, 0x30E3, LineBreakClass::NS}, {0x30E4, 0x30E4, LineBreakClass::ID},
+		{0x30E5, 0x30E5, LineBreakClass::NS}, {0x30E6, 0x30E6, LineBreakClass::ID},
+		{0x30E7, 0x30E7, LineBreakClass::NS}, {0x30E8, 0x30ED, LineBreakClass::ID},
+		{0x30EE, 0x30EE, LineBreakClass::NS}, {0x30EF, 0x30F4, LineBreakClass::ID},
+		{0x30F5, 0x30F6, LineBreakClass::NS}, {0x30F7, 0x30FA, LineBreakClass::ID},
+		{0x30FB, 0x30FE, LineBreakClass::NS}, {0x30FF, 0x31EF, LineBreakClass::ID},
+		{0x31F0, 0x31FF, LineBreakClass::NS}, {0x3200, 0x4DBF, LineBreakClass::ID},
+		{0x4E00, 0xA4CF, LineBreakClass::ID}, {0xAC00, 0xD7AF, LineBreakClass::ID},
+		{0xF900, 0xFAFF, LineBreakClass::ID}, {0xFE00, 0xFE0F, LineBreakClass::CM},
+		{0xFEFF, 0xFEFF, LineBreakClass::WJ}, {0xFF01, 0xFF01, LineBreakClass::EX},
+		{0xFF02, 0xFF07, LineBreakClass::ID}, {0xFF08, 0xFF08, LineBreakClass::OP},
+		{0xFF09, 0xFF09, LineBreakClass::CL}, {0xFF0A, 0xFF0B, LineBreakClass::ID},
+		{0xFF0C, 0xFF0C, LineBreakClass::CL}, {0xFF0D, 0xFF0D, LineBreakClass::ID},
+		{0xFF0E, 0xFF0E, LineBreakClass::CL}, {0xFF0F, 0xFF19, LineBreakClass::ID},
+		{0xFF1A, 0xFF1B, LineBreakClass::NS}, {0xFF1C, 0xFF1E, LineBreakClass::ID},
+		{0xFF1F, 0xFF1F, LineBreakClass::EX}, {0xFF20, 0xFF3A, LineBreakClass::ID},
+		{0xFF3B, 0xFF3B, LineBreakClass::OP}, {0xFF3C, 0xFF3C, LineBreakClass::ID},
+		{0xFF3D, 0xFF3D, LineBreakClass::CL}, {0xFF3E, 0xFF5A, LineBreakClass::ID},
+		{0xFF5B, 0xFF5B, LineBreakClass::OP}, {0xFF5C, 0xFF5C, LineBreakClass::ID},
+		{0xFF5D, 0xFF5D, LineBreakClass::CL}, {0xFF5E, 0xFF5E, LineBreakClass::ID},
+		{0xFF5F, 0xFF5F, LineBreakClass::OP}, {0xFF60, 0xFF61, LineBreakClass::CL},
+		{0xFF62, 0xFF62, LineBreakClass::OP}, {0xFF63, 0xFF64, LineBreakClass::CL},
+		{0xFF65, 0xFF65, LineBreakClass::NS}, {0xFF66, 0xFF66, LineBreakClass::ID},
+		{0xFF67, 0xFF70, LineBreakClass::NS}, {0xFF71, 0xFF9D, LineBreakClass::ID},
+		{0xFF9E, 0xFF9F, LineBreakClass::NS}, {0x1F000, 0x1FAFF, LineBreakClass::ID},
+		{0x20000, 0x3FFFD, LineBreakClass::ID}, {0xE0100, 0xE01EF, LineBreakClass::CM},
+		// clang-format on
+	};
+
+	static_assert(std::ranges::is_sorted(LineBreakRanges, {}, &LineBreakRange::first));
+} // namespace tomolatoon::detail
+
+export namespace tomolatoon
+{
+	/// @brief 文字の改行クラス
+	constexpr LineBreakClass GetLineBreakClass(char32 ch) noexcept {
+		if (ch < detail::LineBreakASCIITable.size())
+		{ return detail::LineBreakASCIITable[ch]; }
+
+		const auto it = std::ranges::upper_bound(detail::LineBreakRanges, ch, {}, &detail::LineBreakRange::first);
+
+		if (it != std::begin(detail::LineBreakRanges) && ch <= std::prev(it)->last)
+		{ return std::prev(it)->lineBreakClass; }
+
+		return LineBreakClass::AL;
+	}
+
+	/// @brief 各文字の直前で改行できるかを、1 文字 1 ビットで持つ
+	struct LineBreakOpportunities
+	{
+		LineBreakOpportunities() = default;
+
+		explicit LineBreakOpportunities(size_t length)
+			: m_bits(((length + 63) / 64), 0)
+			, m_length{length} {}
+
+		/// @brief index 番目の文字の直前で改行できれば true
+		bool operator[](size_t index) const noexcept {
+			return ((m_bits[index / 64] >> (index % 64)) & 1);
+		}
+
+		void set(size_t index) noexcept {
+			m_bits[index / 64] |= (uint64{1} << (index % 64));
+		}
+
+		/// @brief テキストの長さ
+		size_t size() const noexcept {
+			return m_length;
+		}
+
+		/// @brief 改行できる位置の数
+		size_t count() const noexcept {
+			size_t result = 0;
+
+			for (const uint64 word : m_bits)
+			{ result += std::popcount(word); }
+
+			return result;
+		}
+
+		/// @brief 改行できる位置（BudouXParser::parseBoundaries と同じ形式）
+		Array<size_t> boundaries() const {
+			Array<size_t> result;
+
+			for (size_t i = 0; i < m_bits.size(); ++i)
+			{
+				for (uint64 word = m_bits[i]; word != 0; word &= (word - 1))
+				{ result.push_back((i * 64) + std::countr_zero(word)); }
+			}
+
+			return result;
+		}
+
+		/// @brief ビット列
+		const Array<uint64>& bits() const noexcept {
+			return m_bits;
+		}
+
+	private:
+
+		Array<uint64> m_bits;
+
+		size_t m_length = 0;
+	};
+
+	/// @brief UAX #14 の規則と BudouX の分割を合わせて、改行できる位置を求める
+	/// @details
+	/// テキストを 1 回走査し、UAX #14 のペアテーブルで改行の可否を決める。
+	/// スペースの後やハイフンの後など、欧文の規則で改行できる位置はそのまま改行でき、
+	/// それ以外で改行できる位置（漢字や仮名の間など）は、BudouX が境界とした時だけ改行できる。
+	/// 禁則（「。」や「」」の前、欧単語の途中など）では、BudouX の結果に関わらず改行しない。
+	/// BudouX のスコアは禁則にかからない位置でだけ計算する。
+	/// @note 強制改行（改行文字の後）も改行できる位置に含まれる
+	inline LineBreakOpportunities ParseLineBreakOpportunities(const BudouXParser& parser, StringView text) {
+		using enum LineBreakClass;
+
+		LineBreakOpportunities result{text.size()};
+
+		if (text.isEmpty())
+		{ return result; }
+
+		// テキストの先頭や強制改行の直後の文字のクラス
+		const auto startClass = [](LineBreakClass c) {
+			return (c == SP) ? WJ : (c == CM) ? AL : c;
+		};
+
+		// スペースを除いた直前の文字のクラス
+		LineBreakClass before = startClass(GetLineBreakClass(text[0]));
+
+		for (size_t i = 1; i < text.size(); ++i)
+		{
+			const LineBreakClass current = GetLineBreakClass(text[i]);
+			const bool           spaces  = (GetLineBreakClass(text[i - 1]) == SP);
+
+			if (before == BK || before == LF || (before == CR && current != LF))
+			{
+				result.set(i);
+				before = startClass(current);
+				continue;
+			}
+
+			if (current == SP)
+			{ continue; }
+
+			if (current == BK || current == CR || current == LF)
+			{
+				before = current;
+				continue;
+			}
+
+			if (before == ZW)
+			{
+				result.set(i);
+				before = startClass(current);
+				continue;
+			}
+
+			if (current == CM && not spaces)
+			{ continue; }
+
+			const LineBreakClass after = (current == CM) ? AL : current;
+
+			switch (detail::LineBreakPairTable[static_cast<size_t>(before)][static_cast<size_t>(after)])
+			{
+			case detail::LineBreakAction::Prohibited:
+				break;
+			case detail::LineBreakAction::Indirect:
+				if (spaces)
+				{ result.set(i); }
+				break;
+			case detail::LineBreakAction::Direct:
+				if (spaces || before == HY || before == BA || parser.parseCharacter(text, i))
+				{ result.set(i); }
+				break;
+			}
+
+			before = after;
+		}
+
+		return result;
+	}
+} // namespace tomolatoon
@@ -0,0 +1,369 @@
+﻿module;
+#include <bit>
+#include <Siv3D.hpp>
+
+export module tomolatoon.BudouX.sidecar;
+import tomolatoon.BudouX;
+
+namespace tomolatoon::detail
+{
+	// ファイルに保存するので、実装に依存しない固定のハッシュを使う（FNV-1a 64bit）
+	constexpr uint64 SidecarHash(StringView text) noexcept {
+		uint64 hash = 0xcbf29ce484222325;
+
+		for (const char32 ch : text)
+		{
+			for (size_t i = 0; i < 4; ++i)
+			{
+				hash ^= ((static_cast<uint32>(ch) >> (i * 8)) & 0xFF);
+				hash *= 0x100000001b3;
+			}
+		}
+
+		return hash;
+	}
+
+	inline void WriteVarint(Array<uint8>& out, uint64 value) {
+		while (0x80 <= value)
+		{
+			out.push_back(static_cast<uint8>(value | 0x80));
+			value >>= 7;
+		}
+
+		out.push_back(static_cast<uint8>(value));
+	}
+
+	// end を越えて読むか、64 ビットに収まらない場合は none を返す
+	inline Optional<uint64> ReadVarint(const uint8*& p, const uint8* end) noexcept {
+		uint64 value = 0;
+
+		for (uint32 shift = 0; shift < 64; shift += 7)
+		{
+			if (p == end)
+			{ return none; }
+
+			const uint8 byte = *p++;
+
+			value |= (static_cast<uint64>(byte & 0x7F) << shift);
+
+			if (byte < 0x80)
+			{ return value; }
+		}
+
+		return none;
+	}
+} // namespace tomolatoon::detail
+
+export namespace tomolatoon
+{
+	/// @brief 事前に計算した BudouX の境界を保存する、サイドカーファイルの形式
+	/// @details
+	/// [Header][Entry * count][uint32 slot * slotCount][blob]
+	///
+	/// 各文字列の境界は、境界の数と直前の境界からの差分を可変長整数（LEB128）にして blob へ連続して詰める。
+	/// slot はハッシュの下位ビットで引くオープンアドレス法の表で、Entry の番号（空きは EmptySlot）を持つ。
+	struct BudouXSidecarFormat
+	{
+		static constexpr uint32 Magic = 0x43535842; // "BXSC"
+
+		static constexpr uint32 Version = 2;
+
+		static constexpr uint32 EmptySlot = 0xFFFFFFFF;
+
+		struct Header
+		{
+			uint32 magic     = Magic;
+			uint32 version   = Version;
+			uint32 count     = 0;
+			uint32 slotCount = 0;
+			uint64 blobSize  = 0;
+		};
+
+		struct Entry
+		{
+			uint64 hash       = 0;
+			uint64 blobOffset = 0;
+			uint32 length     = 0;
+			uint32 reserved   = 0;
+		};
+
+		static_assert(sizeof(Header) == 24);
+		static_assert(sizeof(Entry) == 24);
+		static_assert(std::endian::native == std::endian::little);
+	};
+
+	/// @brief テキストテーブルの文字列を BudouX で分割し、サイドカーファイルを作る
+	/// @details ビルド時に使う。同じ文字列は 1 つにまとめられる
+	struct BudouXSidecarWriter
+	{
+		/// @brief text を parser で分割して追加する
+		void add(const BudouXParser& parser, StringView text) {
+			if (m_indices.contains(detail::SidecarHash(text)))
+			{ return; }
+
+			add(text, parser.parseBoundaries(text));
+		}
+
+		/// @brief 計算済みの境界を追加する
+		void add(StringView text, const Array<size_t>& boundaries) {
+			const uint64 hash = detail::SidecarHash(text);
+
+			if (m_indices.contains(hash))
+			{ return; }
+
+			m_indices.emplace(hash, static_cast<uint32>(m_entries.size()));
+
+			m_entries.push_back(BudouXSidecarFormat::Entry{
+				.hash       = hash,
+				.blobOffset = m_blob.size(),
+				.length     = static_cast<uint32>(text.size()),
+				.reserved   = 0,
+			});
+
+			detail::WriteVarint(m_blob, boundaries.size());
+
+			size_t previous = 0;
+
+			for (const size_t boundary : boundaries)
+			{
+				detail::WriteVarint(m_blob, (boundary - previous));
+				previous = boundary;
+			}
+		}
+
+		/// @brief 追加された文字列の数
+		size_t size() const noexcept {
+			return m_entries.size();
+		}
+
+		bool save(FilePathView path) const {
+			BinaryWriter writer{path};
+
+			if (not writer)
+			{ return false; }
+
+			// 負荷率を 50% 以下に保つ
+			const uint32 slotCount =
+				std::bit_ceil(static_cast<uint32>(Max<size_t>((m_entries.size() * 2), 1)));
+
+			Array<uint32> slots(slotCount, BudouXSidecarFormat::EmptySlot);
+
+			for (uint32 i = 0; i < m_entries.size(); ++i)
+			{
+				for (uint64 slot = m_entries[i].hash;; ++slot)
+				{
+					if (auto& s = slots[slot & (slotCount - 1)]; s == BudouXSidecarFormat::EmptySlot)
+					{
+						s = i;
+						break;
+					}
+				}
+			}
+
+			const BudouXSidecarFormat::Header header{
+				.count     = static_cast<uint32>(m_entries.size()),
+				.slotCount = slotCount,
+				.blobSize  = m_blob.size(),
+			};
+
+			writer.write(&header, sizeof(header));
+			writer.write(m_entries.data(), (m_entries.size() * sizeof(BudouXSidecarFormat::Entry)));
+			writer.write(slots.data(), (slots.size() * sizeof(uint32)));
+			writer.write(m_blob.data(), m_blob.size());
+
+			return true;
+		}
+
+	private:
+
+		Array<BudouXSidecarFormat::Entry> m_entries;
+
+		Array<uint8> m_blob;
+
+		HashTable<uint64, uint32> m_indices;
+	};
+
+	/// @brief BudouXSidecarWriter で作ったサイドカーファイルを読む
+	/// @details
+	/// ファイルはメモリマップされ、文字列の検索は O(1) で行われる。
+	/// 実行時に分割を行わないので、モデルを読み込む必要も無い。
+	struct BudouXSidecar
+	{
+		BudouXSidecar() = default;
+
+		explicit BudouXSidecar(FilePathView path) {
+			open(path);
+		}
+
+		bool open(FilePathView path) {
+			close();
+
+			if (not m_file.open(path))
+			{ return false; }
+
+			const auto mapped = m_file.mapAll();
+
+			if (not validate(reinterpret_cast<const uint8*>(mapped.data), mapped.size))
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void close() {
+			m_file.close();
+
+			m_header  = nullptr;
+			m_entries = nullptr;
+			m_slots   = nullptr;
+			m_blob    = nullptr;
+		}
+
+		explicit operator bool() const noexcept {
+			return m_header != nullptr;
+		}
+
+		/// @brief 保存されている文字列の数
+		size_t size() const noexcept {
+			return m_header ? m_header->count : 0;
+		}
+
+		/// @brief text に対応するエントリの番号を探す
+		/// @note ハッシュと長さが一致すれば同じ文字列とみなす。壊れた表を指していれば none を返す
+		Optional<size_t> find(StringView text) const noexcept {
+			if (not m_header)
+			{ return none; }
+
+			const uint64 hash = detail::SidecarHash(text);
+			const uint32 mask = (m_header->slotCount - 1);
+
+			// 空きの無い壊れた表でも止まるように、表を 1 周したら諦める
+			for (uint64 slot = hash; slot != (hash + m_header->slotCount); ++slot)
+			{
+				const uint32 index = m_slots[slot & mask];
+
+				if (index == BudouXSidecarFormat::EmptySlot || m_header->count <= index)
+				{ return none; }
+
+				const auto& entry = m_entries[index];
+
+				if (entry.hash == hash && entry.length == text.size())
+				{ return index; }
+			}
+
+			return none;
+		}
+
+		/// @brief index 番目のエントリの境界
+		/// @return 境界が blob の外にはみ出すか、文字列の長さを超える（ファイルが壊れているか、ハッシュが衝突した）場合は none
+		Optional<Array<size_t>> boundaries(size_t index) const {
+			if (not m_header || m_header->count <= index)
+			{ return none; }
+
+			const auto& entry = m_entries[index];
+
+			if (m_header->blobSize <= entry.blobOffset)
+			{ return none; }
+
+			const uint8* p   = (m_blob + entry.blobOffset);
+			const uint8* end = (m_blob + m_header->blobSize);
+
+			const auto count = detail::ReadVarint(p, end);
+
+			// 境界は文字列の中に 1 文字に 1 つまでしか無い
+			if (not count || entry.length < *count)
+			{ return none; }
+
+			Array<size_t> result(static_cast<size_t>(*count));
+
+			uint64 boundary = 0;
+
+			for (auto& e : result)
+			{
+				const auto delta = detail::ReadVarint(p, end);
+
+				if (not delta || (entry.length - boundary) < *delta)
+				{ return none; }
+
+				e = static_cast<size_t>(boundary += *delta);
+			}
+
+			return result;
+		}
+
+		/// @brief BudouXParser::parseView と同じ結果を、保存された境界から作って返す
+		/// @note text が保存されていなかった（か、保存された境界が壊れていた）場合は、分割せずに text 全体を 1 つの文節として返す
+		Array<StringView> parseView(StringView text) const {
+			Array<StringView> result;
+
+			size_t start = 0;
+
+			if (const auto index = find(text))
+			{
+				for (const size_t boundary : boundaries(*index).value_or(Array<size_t>{}))
+				{
+					result.push_back(text.substr(start, (boundary - start)));
+
+					start = boundary;
+				}
+			}
+
+			result.push_back(text.substr(start));
+
+			return result;
+		}
+
+	private:
+
+		bool validate(const uint8* data, size_t size) {
+			using Format = BudouXSidecarFormat;
+
+			if (data == nullptr || size < sizeof(Format::Header))
+			{ return false; }
+
+			const auto* header = reinterpret_cast<const Format::Header*>(data);
+
+			if (header->magic != Format::Magic || header->version != Format::Version
+			    || not std::has_single_bit(header->slotCount))
+			{ return false; }
+
+			// ファイルの値どうしを足したり掛けたりすると桁あふれで検査をすり抜けるので、
+			// 各部分を、残りのバイト数と（割り算で）比べてから差し引く
+			size_t remaining = (size - sizeof(Format::Header));
+
+			if ((remaining / sizeof(Format::Entry)) < header->count)
+			{ return false; }
+
+			const size_t entriesSize = (header->count * sizeof(Format::Entry));
+			remaining -= entriesSize;
+
+			if ((remaining / sizeof(uint32)) < header->slotCount)
+			{ return false; }
+
+			const size_t slotsSize = (header->slotCount * sizeof(uint32));
+			remaining -= slotsSize;
+
+			if (remaining < header->blobSize)
+			{ return false; }
+
+			m_header  = header;
+			m_entries = reinterpret_cast<const Format::Entry*>(data + sizeof(Format::Header));
+			m_slots   = reinterpret_cast<const uint32*>(data + sizeof(Format::Header) + entriesSize);
+			m_blob    = (data + sizeof(Format::Header) + entriesSize + slotsSize);
+
+			return true;
+		}
+
+		MemoryMappedFileView m_file;
+
+		const BudouXSidecarFormat::Header* m_header = nullptr;
+
+		const BudouXSidecarFormat::Entry* m_entries = nullptr;
+
+		const uint32* m_slots = nullptr;
+
+		const uint8* m_blob = nullptr;
+	};
+} // namespace tomolatoon
@@ -0,0 +1,384 @@
+﻿module;
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <Siv3D.hpp>
+
+export module tomolatoon.asset.group;
+import tomolatoon.asset;
+
+export namespace tomolatoon
+{
+	/// @brief グループの読み込みの進み具合
+	struct AssetGroupProgress
+	{
+		/// @brief 構築が終わったアセットの数
+		size_t loadedCount = 0;
+
+		/// @brief 構築に失敗したか、登録されていなかったアセットの数
+		size_t failedCount = 0;
+
+		size_t totalCount = 0;
+
+		/// @brief 構築が終わったアセットの大きさ（バイト）の合計
+		uint64 loadedBytes = 0;
+
+		uint64 totalBytes = 0;
+
+		/// @brief 全てのアセットの構築が終わったか（失敗したものを含む）
+		bool isDone() const noexcept {
+			return ((loadedCount + failedCount) == totalCount);
+		}
+
+		/// @brief 0.0 から 1.0 までの進み具合。大きさが分かっていればバイト数で、分からなければ個数で求める
+		double ratio() const noexcept {
+			if (totalBytes)
+			{ return (static_cast<double>(loadedBytes) / totalBytes); }
+
+			return (totalCount ? (static_cast<double>(loadedCount + failedCount) / totalCount) : 1.0);
+		}
+	};
+
+	/// @brief 種類の違う Asset をまとめて読み込み、破棄するためのグループ
+	/// @details
+	/// グループはコードで Add して作るか、LoadManifest でマニフェストファイルから作る。
+	/// LoadGroupAsync はグループの全てのアセットを AssetWorkerPool に渡すので、構築は全てのスレッドに分散する。
+	/// 構築が終わったアセットは、Poll（またはそれぞれの Asset の Poll）を呼ぶと使えるようになる。
+	///
+	/// マニフェストは JSON か TOML で、グループ名ごとに、種類（RegisterManifestType で登録した名前）、
+	/// キー、ファイルのパス、大きさ（省略するとファイルの大きさ）を並べる。
+	///
+	/// @code
+	/// { "groups": { "title": [ { "type": "texture", "key": "title/logo", "path": "logo.png" } ] } }
+	/// @endcode
+	///
+	/// @code
+	/// [[groups.title]]
+	/// type = "texture"
+	/// key = "title/logo"
+	/// path = "logo.png"
+	/// bytes = 40960
+	/// @endcode
+	struct AssetGroups
+	{
+		/// @brief group に Asset<Trait> の key を加える
+		/// @param bytes 進み具合の表示に使うアセットの大きさ。分からなければ 0
+		template <AssetTraits Trait>
+		static void Add(StringView group, typename Asset<Trait>::KeyRef_t key, uint64 bytes = 0) {
+			using A = Asset<Trait>;
+
+			const typename A::Key_t k(key);
+
+			Member member{
+				.loadAsync = [k](AssetWorkerPool& pool) { return A::LoadAsync(k, pool); },
+				.release   = [k] { A::Release(k); },
+				.isReady   = [k] { return A::IsReady(k); },
+				.bytes     = bytes,
+				.future    = {},
+			};
+
+			std::lock_guard lock{Mutex()};
+
+			Groups()[String{group}].members.push_back(std::move(member));
+
+			// 同じ型の Poll を 2 回登録しないように、型ごとの関数のアドレスで区別する
+			auto& polls = Polls();
+
+			if (not polls.contains(&A::Poll))
+			{ polls.push_back(&A::Poll); }
+		}
+
+		/// @brief グループを削除する。アセットは破棄しない
+		static void Remove(StringView group) {
+			std::lock_guard lock{Mutex()};
+
+			Groups().erase(String{group});
+		}
+
+		static bool Contains(StringView group) {
+			std::lock_guard lock{Mutex()};
+
+			return Groups().contains(String{group});
+		}
+
+		/// @brief グループの全てのアセットを pool のスレッドで構築し始める
+		/// @return グループが存在すれば true
+		static bool LoadGroupAsync(StringView group, AssetWorkerPool& pool = AssetWorkerPool::Default()) {
+			std::lock_guard lock{Mutex()};
+
+			auto it = Groups().find(String{group});
+
+			if (it == Groups().end())
+			{ return false; }
+
+			auto& members = it->second.members;
+
+			for (auto& member : members)
+			{ member.future = member.loadAsync(pool); }
+
+			return true;
+		}
+
+		/// @brief グループの読み込みの進み具合
+		/// @details LoadGroupAsync を呼ぶ前や、読み込みの後に Release されたものは、IsReady かどうかで数える
+		static AssetGroupProgress GetProgress(StringView group) {
+			std::lock_guard lock{Mutex()};
+
+			AssetGroupProgress progress;
+
+			auto it = Groups().find(String{group});
+
+			if (it == Groups().end())
+			{ return progress; }
+
+			for (const auto& member : it->second.members)
+			{
+				++progress.totalCount;
+				progress.totalBytes += member.bytes;
+
+				bool loaded;
+
+				if (member.isReady())
+				{ loaded = true; }
+				else if (member.future.valid()
+				         && member.future.wait_for(std::chrono::seconds{0}) == std::future_status::ready)
+				{ loaded = member.future.get(); }
+				else
+				{ continue; }
+
+				if (loaded)
+				{
+					++progress.loadedCount;
+					progress.loadedBytes += member.bytes;
+				}
+				else
+				{ ++progress.failedCount; }
+			}
+
+			return progress;
+		}
+
+		/// @brief グループの全てのアセットを破棄する
+		/// @note 他のグループにも属するアセットも破棄される
+		static void ReleaseGroup(StringView group) {
+			std::lock_guard lock{Mutex()};
+
+			if (auto it = Groups().find(String{group}); it != Groups().end())
+			{
+				for (auto& member : it->second.members)
+				{
+					member.release();
+					member.future = {};
+				}
+			}
+		}
+
+		/// @brief グループに加えられた全ての型の Asset について Poll を呼ぶ
+		/// @return 新たに読み込まれたアセットの数
+		static size_t Poll() {
+			Array<size_t (*)()> polls;
+
+			{
+				std::lock_guard lock{Mutex()};
+
+				polls = Polls();
+			}
+
+			size_t loaded = 0;
+
+			for (const auto poll : polls)
+			{ loaded += poll(); }
+
+			return loaded;
+		}
+
+		/// @brief マニフェストの type に書く名前と、その登録の仕方を決める
+		/// @param registrar (キー, ファイルのパス) を受け取り、Asset<Trait>::Register を呼ぶ関数
+		template <AssetTraits Trait>
+		static void RegisterManifestType(
+			StringView                                                                 type,
+			std::function<void(typename Asset<Trait>::KeyRef_t key, FilePathView path)> registrar
+		) {
+			using A = Asset<Trait>;
+
+			static_assert(
+				std::constructible_from<typename A::Key_t, String>,
+				"[AssetGroups]: Key must be constructible from String"
+			);
+
+			std::lock_guard lock{Mutex()};
+
+			ManifestTypes().insert_or_assign(
+				String{type},
+				[registrar = std::move(registrar)](
+					StringView    group,
+					const String& key,
+					FilePathView  path,
+					uint64        bytes
+				) {
+					const typename A::Key_t assetKey(key);
+
+					registrar(assetKey, path);
+					Add<Trait>(group, assetKey, bytes);
+				}
+			);
+		}
+
+		/// @brief マニフェストの type に書く名前を決める。アセットはファイルのパスから構築する
+		template <AssetTraits Trait>
+		static void RegisterManifestType(StringView type) {
+			RegisterManifestType<Trait>(type, [](typename Asset<Trait>::KeyRef_t key, FilePathView path) {
+				Asset<Trait>::Register(key, FilePath{path});
+			});
+		}
+
+		/// @brief マニフェストファイル（.json か .toml）を読み込み、アセットを登録してグループに加える
+		/// @details 相対パスは、起動したディレクトリではなく、マニフェストファイルのあるディレクトリを基準にする
+		/// @return 読み込めなかった場合や、登録されていない type があった場合は false（それ以外のエントリは登録される）
+		static bool LoadManifest(FilePathView path) {
+			const String   extension = FileSystem::Extension(path);
+			const FilePath directory = FileSystem::ParentPath(FileSystem::FullPath(path));
+
+			if (extension == U"json")
+			{
+				const JSON json = JSON::Load(path);
+
+				if (not json)
+				{ return false; }
+
+				bool result = true;
+
+				for (const auto& [group, entries] : json[U"groups"])
+				{
+					for (const auto& entry : entries.arrayView())
+					{
+						result &= AddManifestEntry(
+							group,
+							entry[U"type"].getString(),
+							entry[U"key"].getString(),
+							ResolvePath(directory, entry[U"path"].getString()),
+							entry[U"bytes"].getOpt<uint64>()
+						);
+					}
+				}
+
+				return result;
+			}
+			else if (extension == U"toml")
+			{
+				const TOMLReader toml{path};
+
+				if (not toml)
+				{ return false; }
+
+				bool result = true;
+
+				for (const auto& group : toml[U"groups"].tableView())
+				{
+					for (const auto& entry : group.value.tableArrayView())
+					{
+						result &= AddManifestEntry(
+							group.name,
+							entry[U"type"].getString(),
+							entry[U"key"].getString(),
+							ResolvePath(directory, entry[U"path"].getString()),
+							entry[U"bytes"].getOpt<int64>()
+						);
+					}
+				}
+
+				return result;
+			}
+
+			return false;
+		}
+
+	private:
+
+		struct Member
+		{
+			std::function<std::shared_future<bool>(AssetWorkerPool&)> loadAsync;
+
+			std::function<void()> release;
+
+			std::function<bool()> isReady;
+
+			uint64 bytes = 0;
+
+			// 最後の LoadGroupAsync の結果
+			std::shared_future<bool> future;
+		};
+
+		struct Group
+		{
+			Array<Member> members;
+		};
+
+		using ManifestType = std::function<void(StringView group, const String& key, FilePathView path, uint64 bytes)>;
+
+		// マニフェストのあるディレクトリを基準に、相対パスを絶対パスにする
+		// ParentPath は末尾に '/' の付いたパスを返す
+		static FilePath ResolvePath(const FilePath& directory, const FilePath& path) {
+			// "/"（リソースのパスを含む）や "\\" で始まるもの、ドライブ名から始まるものは絶対パス
+			const bool absolute = (path.starts_with(U'/') || path.starts_with(U'\\')
+			                       || (2 <= path.size() && path[1] == U':'));
+
+			if (path.isEmpty() || absolute)
+			{ return path; }
+
+			return FileSystem::FullPath(directory + path);
+		}
+
+		template <class Bytes>
+		static bool AddManifestEntry(
+			StringView             group,
+			const String&          type,
+			const String&          key,
+			const FilePath&        path,
+			const Optional<Bytes>& bytes
+		) {
+			ManifestType manifestType;
+
+			{
+				std::lock_guard lock{Mutex()};
+
+				if (auto it = ManifestTypes().find(type); it != ManifestTypes().end())
+				{ manifestType = it->second; }
+				else
+				{ return false; }
+			}
+
+			// 大きさが書かれていなければ、ファイルの大きさを使う
+			const uint64 size = static_cast<uint64>(bytes ? *bytes : FileSystem::FileSize(path));
+
+			manifestType(group, key, path, size);
+
+			return true;
+		}
+
+		static std::mutex& Mutex() {
+			static std::mutex mutex;
+
+			return mutex;
+		}
+
+		static HashTable<String, Group>& Groups() {
+			static HashTable<String, Group> groups;
+
+			return groups;
+		}
+
+		static Array<size_t (*)()>& Polls() {
+			static Array<size_t (*)()> polls;
+
+			return polls;
+		}
+
+		static HashTable<String, ManifestType>& ManifestTypes() {
+			static HashTable<String, ManifestType> types;
+
+			return types;
+		}
+	};
+} // namespace tomolatoon
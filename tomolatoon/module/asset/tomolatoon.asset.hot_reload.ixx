@@ -0,0 +1,164 @@
+﻿module;
+#include <functional>
+#include <mutex>
+#include <Siv3D.hpp>
+
+export module tomolatoon.asset.hot_reload;
+import tomolatoon.asset.worker_pool;
+
+export namespace tomolatoon
+{
+	/// @brief ファイルが変更されたアセットを、アプリケーションを止めずに作り直す
+	/// @details
+	/// AssetTraits の hotReload を true にした Asset は、Register の引数のうちファイルのパスを覚えておく。
+	/// Watch したディレクトリでそのファイルが変更されると、Update がそれを参照するアセットだけを作り直し始める。
+	/// 作り直したアセットは、次の Update（またはその型の Poll）で入れ替わる。
+	/// 入れ替わるとアセットの世代が進むので、既存のハンドルは次に参照した時に新しいアセットを指す。
+	///
+	/// @code
+	/// AssetHotReload::Watch(U"assets/");
+	///
+	/// while (System::Update())
+	/// {
+	/// 	AssetHotReload::Update();
+	/// }
+	/// @endcode
+	/// @note 作り直しに失敗した場合は、元のアセットをそのまま使う
+	struct AssetHotReload
+	{
+		/// @brief directory 以下（サブディレクトリを含む）のファイルの変更を監視する
+		static void Watch(FilePathView directory) {
+			DirectoryWatcher watcher{directory};
+
+			std::lock_guard lock{Get().mutex};
+
+			Get().watchers.push_back(std::move(watcher));
+		}
+
+		/// @brief 全てのディレクトリの監視をやめる
+		static void UnwatchAll() {
+			std::lock_guard lock{Get().mutex};
+
+			Get().watchers.clear();
+		}
+
+		/// @brief 変更されたファイルを参照するアセットを pool で作り直し始め、作り直し終わったものを入れ替える
+		/// @details 毎フレーム、メインスレッドから呼ぶことを想定している
+		/// @return 作り直しを始めたアセットの数
+		static size_t Update(AssetWorkerPool& pool = AssetWorkerPool::Default()) {
+			auto& instance = Get();
+
+			Array<std::function<void(AssetWorkerPool&)>> reloads;
+			Array<size_t (*)()>                          polls;
+
+			{
+				std::lock_guard lock{instance.mutex};
+
+				// エディタは 1 回の保存で複数回通知することがあるので、1 回の Update の中ではまとめる
+				HashSet<FilePath> changed;
+
+				for (auto& watcher : instance.watchers)
+				{
+					for (const auto& change : watcher.retrieveChanges())
+					{
+						if (change.action == FileAction::Added || change.action == FileAction::Modified
+						    || change.action == FileAction::MovedTo)
+						{ changed.insert(FileSystem::FullPath(change.path)); }
+					}
+				}
+
+				for (const auto& path : changed)
+				{
+					if (auto it = instance.sources.find(path); it != instance.sources.end())
+					{
+						for (const auto& source : it->second)
+						{ reloads.push_back(source.reload); }
+					}
+				}
+
+				polls = instance.polls;
+			}
+
+			// 作り直しは Asset のロックを取るので、このロックの外で始める
+			for (const auto& reload : reloads)
+			{ reload(pool); }
+
+			for (const auto poll : polls)
+			{ poll(); }
+
+			return reloads.size();
+		}
+
+		/// @brief Asset が、id のアセットが path を参照していることを知らせる
+		/// @param poll 作り直したアセットを入れ替える、その Asset の型の Poll
+		static void AddSource(
+			FilePathView                          path,
+			uint64                                id,
+			std::function<void(AssetWorkerPool&)> reload,
+			size_t (*poll)()
+		) {
+			auto& instance = Get();
+
+			const FilePath fullPath = FileSystem::FullPath(path);
+
+			std::lock_guard lock{instance.mutex};
+
+			instance.sources[fullPath].push_back(Source{.id = id, .reload = std::move(reload)});
+			instance.paths[id].push_back(fullPath);
+
+			if (not instance.polls.contains(poll))
+			{ instance.polls.push_back(poll); }
+		}
+
+		/// @brief id のアセットが参照しているファイルを忘れる
+		static void RemoveSources(uint64 id) {
+			auto& instance = Get();
+
+			std::lock_guard lock{instance.mutex};
+
+			auto it = instance.paths.find(id);
+
+			if (it == instance.paths.end())
+			{ return; }
+
+			for (const auto& path : it->second)
+			{
+				auto& sources = instance.sources[path];
+
+				sources.remove_if([id](const Source& source) { return (source.id == id); });
+
+				if (sources.isEmpty())
+				{ instance.sources.erase(path); }
+			}
+
+			instance.paths.erase(it);
+		}
+
+	private:
+
+		struct Source
+		{
+			uint64 id = 0;
+
+			std::function<void(AssetWorkerPool&)> reload;
+		};
+
+		static AssetHotReload& Get() {
+			static AssetHotReload instance;
+
+			return instance;
+		}
+
+		std::mutex mutex;
+
+		Array<DirectoryWatcher> watchers;
+
+		// ファイルの絶対パスから、それを参照するアセットへの対応
+		HashTable<FilePath, Array<Source>> sources;
+
+		// アセットから、それが参照するファイルの絶対パスへの対応
+		HashTable<uint64, Array<FilePath>> paths;
+
+		Array<size_t (*)()> polls;
+	};
+} // namespace tomolatoon
@@ -1,8 +1,26 @@
 ﻿module;
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
+#include <utility>
 #include <Siv3D.hpp>
 
 export module tomolatoon.asset;
+import tomolatoon.asset.hot_reload;
+import tomolatoon.asset.id;
+import tomolatoon.asset.pack;
+import tomolatoon.asset.slot_map;
+import tomolatoon.asset.worker_pool;
 
 export namespace tomolatoon
 {
@@ -18,15 +36,27 @@ export namespace tomolatoon
 
 namespace tomolatoon
 {
+	// アセットパックの中のデータは、構築する時に AssetPackReader にして渡す
+	template <class T>
+	decltype(auto) ResolveArgument(T&& arg) {
+		if constexpr (std::same_as<std::remove_cvref_t<T>, AssetPackSource>)
+		{ return arg.open(); }
+		else
+		{ return std::forward<T>(arg); }
+	}
+
 	template <class Target, class... Args>
 	struct ArgumentsHolder
 	{
 		Target operator()() {
-			return std::make_from_tuple(std::move(args));
+			return std::apply(
+				[](auto&&... values) { return Target(ResolveArgument(std::forward<decltype(values)>(values))...); },
+				std::move(args)
+			);
 		}
 
 		Target operator()() const {
-			return std::make_from_tuple(args);
+			return std::apply([](const auto&... values) { return Target(ResolveArgument(values)...); }, args);
 		}
 
 		std::tuple<Args...> args;
@@ -36,14 +66,63 @@ namespace tomolatoon
 	concept Hashable = requires (T x) {
 		{ std::hash<T>{}(x) } -> std::convertible_to<size_t>;
 	};
+
+	// 読み込みが終わった時に、それを待っている処理を呼ぶ
+	struct AssetCompletion
+	{
+		// 既に終わっていれば、直ちに f を呼ぶ
+		void then(std::function<void(bool)> f) {
+			{
+				std::lock_guard lock{mutex};
+
+				if (not done)
+				{
+					callbacks.push_back(std::move(f));
+					return;
+				}
+			}
+
+			f(result);
+		}
+
+		void complete(bool succeeded) {
+			Array<std::function<void(bool)>> pending;
+
+			{
+				std::lock_guard lock{mutex};
+
+				done    = true;
+				result  = succeeded;
+				pending = std::move(callbacks);
+			}
+
+			for (auto& f : pending)
+			{ f(succeeded); }
+		}
+
+		std::mutex mutex;
+
+		bool done = false;
+
+		bool result = false;
+
+		Array<std::function<void(bool)>> callbacks;
+	};
 } // namespace tomolatoon
 
 export namespace tomolatoon
 {
+	/// @brief Asset の設定
+	/// @details
+	/// キーは既定では AssetID で、レジストリは 64 ビットの ID で引く。
+	/// 文字列から ID へのハッシュは、リテラル（"player/idle"_aid）ならコンパイル時に、それ以外なら ID を作る時に 1 度だけ行う。
 	template <
 		class Value,
-		class Key    = String,
-		class KeyRef = std::conditional_t<std::same_as<Key, String>, StringView, const Key&>>
+		class Key    = AssetID,
+		class KeyRef = std::conditional_t<
+			std::same_as<Key, String>,
+			StringView,
+			std::conditional_t<std::same_as<Key, AssetID>, AssetID, const Key&>>>
 	requires std::convertible_to<KeyRef, Key> && Hashable<Key>
 	struct AssetTraits
 	{
@@ -61,6 +140,59 @@ export namespace tomolatoon
 		/// false の場合、Register で登録した引数は、Load 時にムーブを伴って使用されて消失する。
 		/// したがって、Release した後、再度 Load するには Register を再実行する必要がある。
 		bool holdArguments = true;
+
+		/// @brief レジストリの分割数（2 の累乗）
+		/// @details
+		/// キーのハッシュ値で分割し、分割ごとに読み書きロックを持つ。
+		/// 並行して読み込むスレッドの数より十分大きくすると、ロックの競合が減る。
+		size_t shardCount = 16;
+
+		/// @brief Register の引数のうちファイルのパスを覚え、AssetHotReload でそのファイルの変更を監視するかどうか
+		/// @note true の場合、holdArguments も true であること
+		bool hotReload = false;
+	};
+
+	/// @brief Asset のメモリ予算で使う、アセット 1 つあたりのコスト
+	/// @details 特殊化すると型ごとに変えられる。既定では size_bytes() があればその値を、なければ sizeof を使う
+	template <class Value>
+	struct AssetCost
+	{
+		uint64 operator()(const Value& value) const {
+			if constexpr (requires { { value.size_bytes() } -> std::convertible_to<uint64>; })
+			{ return value.size_bytes(); }
+			else
+			{ return sizeof(Value); }
+		}
+	};
+
+	/// @brief 他のアセットへの依存。Asset<Trait>::Dependency で作る
+	struct AssetDependency
+	{
+		/// @brief 依存先を区別する値（Asset の型とキーのハッシュ値を混ぜたもの）
+		uint64 id = 0;
+
+		/// @brief 循環を報告する時に使う、依存先のキーの名前
+		String name;
+
+		/// @brief 依存先の読み込みを始め、終わったら成功したかどうかを渡して呼ぶ
+		std::function<void(AssetWorkerPool&, std::function<void(bool)>)> loadAsync;
+
+		/// @brief 依存先がまだ読み込まれていなければ、その依存先
+		std::function<Array<AssetDependency>()> dependencies;
+	};
+
+	/// @brief Register のキーの次の引数にして、アセットの依存先を宣言する
+	/// @code
+	/// AtlasAsset::Register(U"atlas", AssetDependsOn{TextureAsset::Dependency(U"atlas/texture")}, U"atlas.json");
+	/// @endcode
+	struct AssetDependsOn
+	{
+		template <class... Dependencies>
+		requires (std::same_as<std::remove_cvref_t<Dependencies>, AssetDependency> && ...)
+		explicit AssetDependsOn(Dependencies&&... args)
+			: dependencies{std::forward<Dependencies>(args)...} {}
+
+		Array<AssetDependency> dependencies;
 	};
 
 	template <AssetTraits Trait>
@@ -70,101 +202,911 @@ export namespace tomolatoon
 		using Key_t    = decltype(Trait.keyType)::type;
 		using KeyRef_t = decltype(Trait.keyRefType)::type;
 
+		static_assert(std::has_single_bit(Trait.shardCount), "[Asset]: shardCount must be a power of two");
+
+		static_assert(
+			(not Trait.hotReload || Trait.holdArguments),
+			"[Asset]: hotReload requires holdArguments to rebuild the asset"
+		);
+
+		/// @brief key のアセットを読み込み、それを指すハンドルを作る
+		/// @details
+		/// ハンドルはアセットの格納場所と、その時点の世代を保持する。
+		/// 参照する時は分割の共有ロックの下で世代を比べるだけで、Release や再読み込みで世代が変わった時だけ読み込み直す。
 		Asset(KeyRef_t key)
 			: m_key(key) {
-			if (not Load(key))
-			{ throw Error(U"[Asset::Asset]: Asset `{}` is not registered"_fmt(key)); }
+			resolve();
 		}
 
 		template <class... Args>
 		static void Register(KeyRef_t key, Args&&... args) noexcept {
-			if constexpr (Trait.holdArguments)
-			{
-				m_assetConstructors.emplace(
-					Key_t(key),
-					std::as_const(
-						ArgumentsHolder{.args = std::make_tuple(std::forward<Args>(args)...)}
-					)
-				);
-			}
-			else
-			{
-				m_assetConstructors.emplace(
-					Key_t(key),
-					ArgumentsHolder{.args = std::make_tuple(std::forward<Args>(args)...)}
-				);
-			}
+			auto sources = SourcePaths(args...);
+
+			SetConstructor(key, MakeConstructor(std::forward<Args>(args)...), {}, std::move(sources));
+		}
+
+		/// @brief 依存先を宣言して登録する
+		/// @details
+		/// 読み込む時は依存先を全て読み込んでから構築するので、構築の中で依存先の Asset を参照できる。
+		/// 依存先のどれかが読み込めなければ、このアセットも読み込めない。
+		template <class... Args>
+		static void Register(KeyRef_t key, AssetDependsOn dependsOn, Args&&... args) noexcept {
+			auto sources = SourcePaths(args...);
+
+			SetConstructor(
+				key,
+				MakeConstructor(std::forward<Args>(args)...),
+				std::move(dependsOn.dependencies),
+				std::move(sources)
+			);
+		}
+
+		/// @brief アセットパックの全てのアセットを、その ID をキーにして登録する
+		/// @details 構築には、アセットのデータを読む AssetPackReader と、それに続けて args を渡す
+		template <class... Args>
+		requires std::same_as<Key_t, AssetID>
+		static void RegisterPack(const AssetPack& pack, const Args&... args) {
+			for (const auto id : pack.ids())
+			{ Register(id, AssetPackSource{.pack = pack, .id = id}, args...); }
 		}
 
+		/// @brief 他のアセットの Register で、このアセットへの依存を宣言するための値
+		static AssetDependency Dependency(KeyRef_t key) {
+			const Key_t k(key);
+
+			return AssetDependency{
+				.id           = GlobalID(k),
+				.name         = Format(k),
+				.loadAsync    = [k](AssetWorkerPool& pool, std::function<void(bool)> onDone) {
+					Schedule(k, pool).completion->then(std::move(onDone));
+				},
+				.dependencies = [k] { return GetDependencies(k); },
+			};
+		}
+
+		/// @brief アセットを呼び出したスレッドで構築する
+		/// @details
+		/// 依存先があれば、それらを AssetWorkerPool::Default() で並列に読み込み、全て読み込まれるまで待つ。
+		/// AssetWorkerPool のスレッド（例えば、他のアセットの構築の中）から呼ばれたら、そのプールで読み込み、
+		/// 待つ間にそのプールのまだ始まっていない仕事を実行する。したがって、依存の深さがスレッド数を超えても止まらない。
+		/// @note 他のスレッドや LoadAsync で同じキーを構築中なら、新たには構築せずにその完了を待つ
+		/// @exception Error 依存が循環している場合
 		static bool Load(KeyRef_t key) {
 			if (IsReady(key))
 			{ return true; }
 
-			if (IsRegistered(key))
+			const bool dependenciesLoaded = LoadDependencies(key);
+
+			Loading loading;
+			Task    task;
+
 			{
-				try
-				{
-					m_assets.emplace(Key_t(key), m_assetConstructors[key]());
+				auto&            shard = GetShard(key);
+				std::unique_lock lock{shard.mutex};
 
-					if constexpr (not Trait.holdArguments)
-					{ m_assetConstructors.erase(key); }
-					return true;
+				if (shard.isReady(key))
+				{ return true; }
+
+				if (auto it = shard.loading.find(key); it != shard.loading.end())
+				{ loading = it->second; }
+				else if (auto it = shard.constructors.find(key); it != shard.constructors.end())
+				{
+					std::tie(loading, task) = MakeLoading(it->second);
+					shard.loading.emplace(Key_t(key), loading);
 				}
-				catch (...)
+				else
 				{ return false; }
 			}
-			else
+
+			// 構築はロックの外で行い、同じ分割の他のキーを止めないようにする
+			if (task.valid())
+			{ Run(task, loading, dependenciesLoaded); }
+
+			return Publish(key, loading);
+		}
+
+		/// @brief アセットを pool のスレッドで構築する
+		/// @details
+		/// 構築が終わっても、Poll（または Load）を呼ぶまでは IsReady にならない。
+		/// 既に読み込み済みか読み込み中なら、新たには構築しない。
+		///
+		/// 依存先があれば、それらを先に pool で読み込む。互いに依存しないものは並列に読み込み、
+		/// 依存先が全て読み込まれた時に（最後の依存先を構築したスレッドから）このアセットの構築を pool に積む。
+		/// @return 構築に成功したかどうかを返す future。未登録なら直ちに false になる
+		/// @exception Error 依存が循環している場合
+		static std::shared_future<bool> LoadAsync(
+			KeyRef_t         key,
+			AssetWorkerPool& pool = AssetWorkerPool::Default()
+		) {
+			ThrowIfCircular(key);
+
+			return Schedule(key, pool).future;
+		}
+
+		/// @brief 読み込み済みのアセットを pool のスレッドで作り直す
+		/// @details
+		/// 作り直している間も元のアセットを使える。作り直し終わったものは Poll で入れ替わり、
+		/// ハンドルは世代が進んだことで、次に参照した時に新しいアセットを指す。
+		/// 作り直している途中で再び呼ばれたら、途中の結果は捨てて作り直す（ファイルが書き込み途中だったかもしれないため）。
+		/// @return 作り直しを始めたら true。読み込まれていないか、登録されていなければ false
+		/// @note 作り直しに失敗したら、元のアセットをそのまま使う
+		static bool Reload(KeyRef_t key, AssetWorkerPool& pool = AssetWorkerPool::Default()) {
+			auto&            shard = GetShard(key);
+			std::unique_lock lock{shard.mutex};
+
+			const auto it = shard.constructors.find(key);
+
+			if (not shard.isReady(key) || it == shard.constructors.end())
 			{ return false; }
+
+			auto [loading, task] = MakeLoading(it->second);
+
+			shard.loading.insert_or_assign(Key_t(key), loading);
+
+			lock.unlock();
+
+			// 読み込み済みなので、依存先も読み込まれている
+			pool.submit([task = std::make_shared<Task>(std::move(task)), loading] { Run(*task, loading, true); });
+
+			return true;
+		}
+
+		/// @brief LoadAsync（または Reload）で読み込み中で、まだ Poll されていないかどうか
+		static bool IsLoading(KeyRef_t key) {
+			auto&            shard = GetShard(key);
+			std::shared_lock lock{shard.mutex};
+
+			return shard.loading.contains(key);
+		}
+
+		/// @brief 構築が終わったアセットを IsReady にする
+		/// @details 毎フレーム、メインスレッドから呼ぶことを想定している
+		/// 最後に Trim を呼び、メモリ予算を超えていれば古いアセットから破棄する。
+		/// @return 新たに読み込まれたアセットの数
+		static size_t Poll() {
+			size_t loaded = 0;
+
+			for (auto& shard : m_shards)
+			{
+				Array<std::pair<Key_t, Loading>> finished;
+
+				{
+					std::shared_lock lock{shard.mutex};
+
+					for (const auto& [key, loading] : shard.loading)
+					{
+						if (loading.future.wait_for(std::chrono::seconds{0}) == std::future_status::ready)
+						{ finished.emplace_back(key, loading); }
+					}
+				}
+
+				for (auto& [key, loading] : finished)
+				{
+					if (Publish(key, loading))
+					{ ++loaded; }
+				}
+			}
+
+			Trim();
+
+			return loaded;
+		}
+
+		/// @brief 読み込み済みのアセットのコストの合計の上限を設定する
+		/// @details
+		/// 上限を超えると、Poll か Trim の時に、最後に参照されたのが古いものから破棄する。
+		/// 破棄したアセットは、ハンドルから次に参照した時に Register した引数から作り直される。
+		/// 破棄したアセットを指す参照は無効になるので、参照を保持し続けるアセットは Pin すること。
+		/// @note Pin したものと、引数を保持していない（holdArguments が false の）ものは破棄しない
+		static void SetMemoryBudget(uint64 budget) noexcept {
+			m_memoryBudget.store(budget, std::memory_order_relaxed);
+		}
+
+		static uint64 GetMemoryBudget() noexcept {
+			return m_memoryBudget.load(std::memory_order_relaxed);
+		}
+
+		/// @brief 読み込み済みのアセットのコストの合計
+		static uint64 GetMemoryUsage() noexcept {
+			return m_memoryUsage.load(std::memory_order_relaxed);
+		}
+
+		/// @brief アセットのコストの求め方を設定する。既定では AssetCost<Value_t> を使う
+		/// @note 読み込みを始める前に呼ぶこと。設定より前に読み込まれたもののコストは変わらない
+		static void SetCostFunction(std::function<uint64(const Value_t&)> cost) {
+			m_costFunction = (cost ? std::move(cost) : AssetCost<Value_t>{});
+		}
+
+		/// @brief key のアセットをメモリ予算による破棄の対象から外す
+		/// @note 読み込む前でも Pin できる
+		static void Pin(KeyRef_t key) {
+			auto&            shard = GetShard(key);
+			std::unique_lock lock{shard.mutex};
+
+			shard.setPinned(key, true);
+		}
+
+		static void Unpin(KeyRef_t key) {
+			auto&            shard = GetShard(key);
+			std::unique_lock lock{shard.mutex};
+
+			shard.setPinned(key, false);
+		}
+
+		static bool IsPinned(KeyRef_t key) {
+			auto&            shard = GetShard(key);
+			std::shared_lock lock{shard.mutex};
+
+			const auto it = shard.index.find(key);
+
+			return (it != shard.index.end() && it->second.pinned);
+		}
+
+		/// @brief メモリ予算を超えていれば、最後に参照されたのが古いものから予算内に収まるまで破棄する
+		/// @details
+		/// 破棄したアセットを指す参照だけが無効になる（他のアセットは動かない）。
+		/// どのアセットが破棄されるかは参照の順で決まるので、Pin していないアセットの参照は、
+		/// フレームの区切りなど、Trim（や Poll）を呼ぶ前に手放すこと。
+		/// @return 破棄したアセットの数
+		static size_t Trim() {
+			// ここより後の参照は、ここより前の参照より新しい
+			m_tick.fetch_add(1, std::memory_order_relaxed);
+
+			// 引数を保持していなければ、作り直せないので破棄しない
+			if (not Trait.holdArguments || GetMemoryUsage() <= GetMemoryBudget())
+			{ return 0; }
+
+			struct Candidate
+			{
+				Shard* shard;
+
+				SlotMapKey slot;
+
+				uint64 lastAccess;
+			};
+
+			Array<Candidate> candidates;
+
+			for (auto& shard : m_shards)
+			{
+				std::shared_lock lock{shard.mutex};
+
+				shard.values.forEach([&](SlotMapKey slot, Stored& stored) {
+					if (not stored.pinned)
+					{ candidates.push_back(Candidate{&shard, slot, stored.lastAccessed()}); }
+				});
+			}
+
+			std::ranges::sort(candidates, {}, &Candidate::lastAccess);
+
+			size_t evicted = 0;
+
+			for (const auto& candidate : candidates)
+			{
+				if (GetMemoryUsage() <= GetMemoryBudget())
+				{ break; }
+
+				std::unique_lock lock{candidate.shard->mutex};
+
+				// 集めてから、他のスレッドが Release か Pin したかもしれない
+				if (const Stored* stored = candidate.shard->values.find(candidate.slot); stored && not stored->pinned)
+				{
+					candidate.shard->erase(candidate.slot);
+					++evicted;
+				}
+			}
+
+			return evicted;
+		}
+
+		/// @brief 読み込み済みのアセット全てについて f(キー, 値) を呼ぶ
+		/// @details 分割ごとに、値へのポインタが密に並んだ配列を先頭から辿る
+		/// @note f の中でこの型の Asset の関数を呼ばないこと（分割のロックを持ったまま呼ぶため）
+		template <class F>
+		static void ForEach(F&& f) {
+			for (auto& shard : m_shards)
+			{
+				std::shared_lock lock{shard.mutex};
+
+				shard.values.forEach([&](SlotMapKey, Stored& stored) { f(std::as_const(stored.key), stored.value); });
+			}
 		}
 
 		static bool IsRegistered(KeyRef_t key) {
-			return m_assetConstructors.contains(key);
+			auto&            shard = GetShard(key);
+			std::shared_lock lock{shard.mutex};
+
+			return shard.constructors.contains(key);
 		}
 
 		static bool IsReady(KeyRef_t key) {
-			return m_assets.contains(key);
+			auto&            shard = GetShard(key);
+			std::shared_lock lock{shard.mutex};
+
+			return shard.isReady(key);
 		}
 
+		/// @brief ハンドルが指すアセット
+		/// @details Release されていれば読み込み直し、読み込めなければ例外を投げる
+		/// @note 返す参照は、そのキーが Release されるか、読み込み直されるか、メモリ予算で破棄されるまで有効。
+		/// 他のキーの読み込みや破棄では無効にならない
 		operator Value_t&() {
-			return m_assets[m_key];
+			return get();
 		}
 
 		operator const Value_t&() const {
-			return std::as_const(m_assets[m_key]);
+			return std::as_const(get());
 		}
 
 		Value_t& operator()() {
-			return m_assets[m_key];
+			return get();
 		}
 
 		const Value_t& operator()() const {
-			return std::as_const(m_assets[m_key]);
+			return std::as_const(get());
 		}
 
+		/// @note 読み込み中のものは、構築の結果を捨てる
 		static void Release(KeyRef_t key) {
-			m_assets.erase(key);
+			auto&            shard = GetShard(key);
+			std::unique_lock lock{shard.mutex};
+
+			shard.release(key);
+			shard.loading.erase(key);
 		}
 
 		static void ReleaseAll() {
-			m_assets.clear();
+			for (auto& shard : m_shards)
+			{
+				std::unique_lock lock{shard.mutex};
+
+				shard.releaseAll();
+				shard.loading.clear();
+			}
 		}
 
 		static void Unregister(KeyRef_t key) {
-			m_assets.erase(key);
-			m_assetConstructors.erase(key);
+			{
+				auto&            shard = GetShard(key);
+				std::unique_lock lock{shard.mutex};
+
+				shard.release(key);
+				shard.loading.erase(key);
+				shard.constructors.erase(key);
+				shard.dependencies.erase(key);
+			}
+
+			if constexpr (Trait.hotReload)
+			{ AssetHotReload::RemoveSources(GlobalID(Key_t(key))); }
 		}
 
 		static void UnregisterAll() {
-			m_assets.clear();
-			m_assetConstructors.clear();
+			for (auto& shard : m_shards)
+			{
+				Array<uint64> ids;
+
+				{
+					std::unique_lock lock{shard.mutex};
+
+					if constexpr (Trait.hotReload)
+					{
+						for (const auto& [key, constructor] : shard.constructors)
+						{ ids.push_back(GlobalID(key)); }
+					}
+
+					shard.releaseAll();
+					shard.loading.clear();
+					shard.constructors.clear();
+					shard.dependencies.clear();
+				}
+
+				for (const auto id : ids)
+				{ AssetHotReload::RemoveSources(id); }
+			}
 		}
 
 	private:
 
+		using Constructor = std::function<Value_t()>;
+
+		// 依存先が全て読み込めたかどうかを受け取り、構築に成功したかどうかを返す
+		using Task = std::packaged_task<bool(bool)>;
+
+		struct Loading
+		{
+			std::shared_future<bool> future;
+
+			// 構築したアセット。構築したスレッドが書き込み、future の完了後に Publish が読む
+			std::shared_ptr<Optional<Value_t>> value;
+
+			// このアセットに依存するものの構築は、ここから始める
+			std::shared_ptr<AssetCompletion> completion;
+		};
+
+		// 読み込み済みのアセット
+		struct Stored
+		{
+			Value_t value;
+
+			Key_t key;
+
+			uint64 cost = 0;
+
+			// 最後に参照された時の m_tick。複数のハンドルが共有ロックの下で同時に書き込むので std::atomic_ref で扱う
+			alignas(std::atomic_ref<uint64>::required_alignment) uint64 lastAccess = 0;
+
+			bool pinned = false;
+
+			uint64 lastAccessed() noexcept {
+				return std::atomic_ref{lastAccess}.load(std::memory_order_relaxed);
+			}
+
+			void touch() noexcept {
+				const uint64 tick = m_tick.load(std::memory_order_relaxed);
+
+				// 同じ値を書き込んで、キャッシュラインを無駄に汚さないようにする
+				if (lastAccessed() != tick)
+				{ std::atomic_ref{lastAccess}.store(tick, std::memory_order_relaxed); }
+			}
+		};
+
+		struct IndexEntry
+		{
+			// 読み込まれていなければ無効か、古い世代のキー
+			SlotMapKey slot;
+
+			bool pinned = false;
+		};
+
+		// キャッシュラインを共有して、別の分割のロックと競合しないようにする
+		struct alignas(64) Shard
+		{
+			mutable std::shared_mutex mutex;
+
+			HashTable<Key_t, Constructor> constructors;
+
+			// 依存先を宣言して登録したものだけが入る
+			HashTable<Key_t, Array<AssetDependency>> dependencies;
+
+			// 値は SlotMap に持ち、キーからはその位置を引く。値は削除するまで動かない
+			SlotMap<Stored> values;
+
+			HashTable<Key_t, IndexEntry> index;
+
+			HashTable<Key_t, Loading> loading;
+
+			SlotMapKey find(KeyRef_t key) const {
+				const auto it = index.find(key);
+
+				return ((it != index.end() && values.contains(it->second.slot)) ? it->second.slot : SlotMapKey{});
+			}
+
+			bool isReady(KeyRef_t key) const {
+				return find(key).isValid();
+			}
+
+			void setPinned(KeyRef_t key, bool pinned) {
+				auto& entry = index.try_emplace(Key_t(key)).first->second;
+
+				entry.pinned = pinned;
+
+				if (Stored* stored = values.find(entry.slot))
+				{ stored->pinned = pinned; }
+			}
+
+			void store(KeyRef_t key, Value_t&& value, uint64 cost) {
+				auto& entry = index.try_emplace(Key_t(key)).first->second;
+
+				erase(entry.slot);
+
+				entry.slot = values.emplace(Stored{
+					.value  = std::move(value),
+					.key    = Key_t(key),
+					.cost   = cost,
+					.pinned = entry.pinned,
+				});
+
+				values.find(entry.slot)->touch();
+
+				m_memoryUsage.fetch_add(cost, std::memory_order_relaxed);
+			}
+
+			void erase(SlotMapKey slot) {
+				if (const Stored* stored = values.find(slot))
+				{
+					m_memoryUsage.fetch_sub(stored->cost, std::memory_order_relaxed);
+					values.erase(slot);
+				}
+			}
+
+			void release(KeyRef_t key) {
+				erase(find(key));
+			}
+
+			void releaseAll() {
+				values.forEach([](SlotMapKey, const Stored& stored) {
+					m_memoryUsage.fetch_sub(stored.cost, std::memory_order_relaxed);
+				});
+
+				values.clear();
+			}
+		};
+
+		static Shard& GetShard(KeyRef_t key) {
+			if constexpr (Trait.shardCount == 1)
+			{ return m_shards[0]; }
+			else
+			{
+				using Hashed = std::remove_cvref_t<KeyRef_t>;
+
+				uint64 hash;
+
+				if constexpr (Hashable<Hashed>)
+				{ hash = std::hash<Hashed>{}(key); }
+				else
+				{ hash = std::hash<Key_t>{}(Key_t(key)); }
+
+				// 各分割のテーブル内の位置と相関しないように、混ぜてから上位ビットで分ける
+				constexpr int32 Shift = (64 - std::countr_zero(Trait.shardCount));
+
+				return m_shards[(hash * 0x9E37'79B9'7F4A'7C15) >> Shift];
+			}
+		}
+
+		template <class... Args>
+		static Constructor MakeConstructor(Args&&... args) {
+			using Holder = ArgumentsHolder<Value_t, std::decay_t<Args>...>;
+
+			if constexpr (Trait.holdArguments)
+			{ return [holder = Holder{.args = {std::forward<Args>(args)...}}] { return holder(); }; }
+			else
+			{
+				// std::function はコピー可能である必要があるので、ムーブのみ可能な引数のために共有する
+				return [holder = std::make_shared<Holder>(Holder{.args = {std::forward<Args>(args)...}})] {
+					return std::move(*holder)();
+				};
+			}
+		}
+
+		// Register の引数のうち、ファイルを指すパス
+		template <class... Args>
+		static Array<FilePath> SourcePaths(const Args&... args) {
+			Array<FilePath> paths;
+
+			if constexpr (Trait.hotReload)
+			{
+				const auto add = [&]<class Arg>(const Arg& arg) {
+					if constexpr (std::convertible_to<const Arg&, FilePathView>)
+					{
+						if (const FilePathView path{arg}; FileSystem::IsFile(path))
+						{ paths.emplace_back(path); }
+					}
+				};
+
+				(add(args), ...);
+			}
+
+			return paths;
+		}
+
+		static void SetConstructor(
+			KeyRef_t               key,
+			Constructor            constructor,
+			Array<AssetDependency> dependencies,
+			Array<FilePath>        sources
+		) {
+			{
+				auto&            shard = GetShard(key);
+				std::unique_lock lock{shard.mutex};
+
+				// 登録済みなら何もしない
+				if (not shard.constructors.emplace(Key_t(key), std::move(constructor)).second)
+				{ return; }
+
+				if (not dependencies.isEmpty())
+				{ shard.dependencies.emplace(Key_t(key), std::move(dependencies)); }
+			}
+
+			if constexpr (Trait.hotReload)
+			{
+				const Key_t k(key);
+
+				const auto reload = [k](AssetWorkerPool& pool) { Reload(k, pool); };
+
+				for (const auto& source : sources)
+				{ AssetHotReload::AddSource(source, GlobalID(k), reload, &Poll); }
+			}
+		}
+
+		// Asset の型をまたいでアセットを区別する値
+		// 型ごとに異なる値（この型の m_shards のアドレス）とキーのハッシュ値を混ぜる
+		static uint64 GlobalID(const Key_t& key) {
+			const auto type = static_cast<uint64>(reinterpret_cast<std::uintptr_t>(&m_shards));
+
+			return ((std::hash<Key_t>{}(key) * 0x9E37'79B9'7F4A'7C15) ^ type);
+		}
+
+		// まだ読み込まれていなければ、宣言された依存先
+		static Array<AssetDependency> GetDependencies(KeyRef_t key) {
+			auto&            shard = GetShard(key);
+			std::shared_lock lock{shard.mutex};
+
+			if (shard.isReady(key))
+			{ return {}; }
+
+			const auto it = shard.dependencies.find(key);
+
+			return ((it != shard.dependencies.end()) ? it->second : Array<AssetDependency>{});
+		}
+
+		// key から依存をたどり、循環していれば例外を投げる
+		static void ThrowIfCircular(KeyRef_t key) {
+			HashSet<uint64>        visited;
+			Array<AssetDependency> path;
+
+			const auto visit = [&](const auto& self, const AssetDependency& dependency) -> void {
+				if (visited.contains(dependency.id))
+				{ return; }
+
+				if (auto it = std::ranges::find(path, dependency.id, &AssetDependency::id); it != path.end())
+				{
+					String cycle;
+
+					for (; it != path.end(); ++it)
+					{ cycle += (it->name + U" -> "); }
+
+					throw Error(U"[Asset]: Circular dependency `{}{}`"_fmt(cycle, dependency.name));
+				}
+
+				path.push_back(dependency);
+
+				for (const auto& next : dependency.dependencies())
+				{ self(self, next); }
+
+				path.pop_back();
+
+				visited.insert(dependency.id);
+			};
+
+			visit(visit, Dependency(key));
+		}
+
+		// 依存先を全て pool で読み込み始め、全て終わったら f(全て読み込めたか) を呼ぶ
+		// f は、最後に終わった依存先を構築したスレッドから呼ばれる
+		static void WhenLoaded(
+			const Array<AssetDependency>& dependencies,
+			AssetWorkerPool&              pool,
+			std::function<void(bool)>     f
+		) {
+			if (dependencies.isEmpty())
+			{
+				f(true);
+				return;
+			}
+
+			struct State
+			{
+				std::atomic<size_t> remaining = 0;
+
+				std::atomic<bool> succeeded = true;
+
+				std::function<void(bool)> f;
+			};
+
+			auto state = std::make_shared<State>();
+
+			state->remaining.store(dependencies.size(), std::memory_order_relaxed);
+			state->f = std::move(f);
+
+			for (const auto& dependency : dependencies)
+			{
+				dependency.loadAsync(pool, [state](bool succeeded) {
+					if (not succeeded)
+					{ state->succeeded.store(false, std::memory_order_relaxed); }
+
+					if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					{ state->f(state->succeeded.load(std::memory_order_relaxed)); }
+				});
+			}
+		}
+
+		// 依存先を並列に読み込み、全て終わるまで待つ
+		// プールのスレッドから呼ばれたら、そのプールに積んで、待つ間は自分でも実行する
+		static bool LoadDependencies(KeyRef_t key) {
+			const auto dependencies = GetDependencies(key);
+
+			if (dependencies.isEmpty())
+			{ return true; }
+
+			ThrowIfCircular(key);
+
+			// 待つ側が先に戻っても、知らせる側が触れられるように共有する
+			auto promise = std::make_shared<std::promise<bool>>();
+			auto future  = promise->get_future();
+
+			AssetWorkerPool* current = AssetWorkerPool::Current();
+
+			WhenLoaded(dependencies, (current ? *current : AssetWorkerPool::Default()), [promise](bool succeeded) {
+				promise->set_value(succeeded);
+			});
+
+			AssetWorkerPool::Wait(future);
+
+			return future.get();
+		}
+
+		// key の構築を pool に積む。依存先があれば、それらが全て読み込まれた時に積む
+		static Loading Schedule(KeyRef_t key, AssetWorkerPool& pool) {
+			auto&            shard = GetShard(key);
+			std::unique_lock lock{shard.mutex};
+
+			if (auto it = shard.loading.find(key); it != shard.loading.end())
+			{ return it->second; }
+
+			const bool ready = shard.isReady(key);
+
+			if (ready || not shard.constructors.contains(key))
+			{ return MakeFinished(ready); }
+
+			auto [loading, task] = MakeLoading(shard.constructors.find(key)->second);
+
+			shard.loading.emplace(Key_t(key), loading);
+
+			Array<AssetDependency> dependencies;
+
+			if (auto it = shard.dependencies.find(key); it != shard.dependencies.end())
+			{ dependencies = it->second; }
+
+			lock.unlock();
+
+			WhenLoaded(
+				dependencies,
+				pool,
+				[pool = &pool, task = std::make_shared<Task>(std::move(task)), loading](bool dependenciesLoaded) {
+					pool->submit([task, loading, dependenciesLoaded] { Run(*task, loading, dependenciesLoaded); });
+				}
+			);
+
+			return loading;
+		}
+
+		static std::pair<Loading, Task> MakeLoading(Constructor constructor) {
+			auto value = std::make_shared<Optional<Value_t>>();
+
+			Task task{[constructor = std::move(constructor), value](bool dependenciesLoaded) {
+				// 依存先を読み込めなければ、構築しない
+				if (not dependenciesLoaded)
+				{ return false; }
+
+				try
+				{
+					value->emplace(constructor());
+					return true;
+				}
+				catch (...)
+				{ return false; }
+			}};
+
+			return {
+				Loading{
+					.future     = task.get_future().share(),
+					.value      = std::move(value),
+					.completion = std::make_shared<AssetCompletion>(),
+				},
+				std::move(task),
+			};
+		}
+
+		// 読み込み済みか未登録で、構築しないもの
+		static Loading MakeFinished(bool ready) {
+			std::promise<bool> promise;
+			promise.set_value(ready);
+
+			auto completion = std::make_shared<AssetCompletion>();
+			completion->complete(ready);
+
+			return Loading{
+				.future     = promise.get_future().share(),
+				.value      = nullptr,
+				.completion = std::move(completion),
+			};
+		}
+
+		// 構築し、このアセットに依存するものに知らせる
+		static void Run(Task& task, const Loading& loading, bool dependenciesLoaded) {
+			task(dependenciesLoaded);
+
+			loading.completion->complete(loading.future.get());
+		}
+
+		// 構築の完了を待ち、成功していれば values に移す
+		static bool Publish(KeyRef_t key, const Loading& loading) {
+			// 構築がプールに積まれたままなら、待つ間に実行する
+			AssetWorkerPool::Wait(loading.future);
+
+			const bool succeeded = loading.future.get();
+
+			auto&            shard = GetShard(key);
+			std::unique_lock lock{shard.mutex};
+
+			// 他のスレッドが先に移したか、Release で取り消された
+			if (auto it = shard.loading.find(key); it == shard.loading.end() || it->second.value != loading.value)
+			{ return (succeeded && shard.isReady(key)); }
+			else
+			{ shard.loading.erase(it); }
+
+			if (not succeeded)
+			{ return false; }
+
+			const uint64 cost = m_costFunction(**loading.value);
+
+			shard.store(key, std::move(**loading.value), cost);
+
+			if constexpr (not Trait.holdArguments)
+			{
+				shard.constructors.erase(key);
+				shard.dependencies.erase(key);
+			}
+
+			return true;
+		}
+
+		Value_t& get() const {
+			// 他のスレッドが同じ分割に挿入・削除していても読めるように、共有ロックの下で引く
+			if (m_shard)
+			{
+				std::shared_lock lock{m_shard->mutex};
+
+				if (Stored* stored = m_shard->values.find(m_slot))
+				{
+					stored->touch();
+					return stored->value;
+				}
+			}
+
+			return resolve();
+		}
+
+		// 読み込んで、値の位置を覚え直す
+		Value_t& resolve() const {
+			auto& shard = GetShard(m_key);
+
+			for (;;)
+			{
+				if (not Load(m_key))
+				{ throw Error(U"[Asset::Asset]: Asset `{}` is not registered or failed to load"_fmt(m_key)); }
+
+				std::shared_lock lock{shard.mutex};
+
+				// Load から戻るまでに、他のスレッドが Release したかもしれない
+				if (const SlotMapKey slot = shard.find(m_key); slot.isValid())
+				{
+					m_shard = &shard;
+					m_slot  = slot;
+
+					Stored* stored = shard.values.find(slot);
+					stored->touch();
+					return stored->value;
+				}
+			}
+		}
+
 		Key_t m_key;
 
-		inline static HashTable<Key_t, std::function<T()>> m_assetConstructors;
+		mutable Shard* m_shard = nullptr;
+
+		// SlotMap のキー。Release や読み込み直しで世代が進むと無効になる
+		mutable SlotMapKey m_slot;
+
+		inline static std::array<Shard, Trait.shardCount> m_shards;
+
+		inline static std::function<uint64(const Value_t&)> m_costFunction = AssetCost<Value_t>{};
+
+		inline static std::atomic<uint64> m_memoryBudget = std::numeric_limits<uint64>::max();
+
+		inline static std::atomic<uint64> m_memoryUsage = 0;
 
-		inline static HashTable<Key_t, T> m_assets;
+		// Trim のたびに進む時刻。アセットの最後に参照された時刻の比較に使う
+		inline static std::atomic<uint64> m_tick = 1;
 	};
 } // namespace tomolatoon
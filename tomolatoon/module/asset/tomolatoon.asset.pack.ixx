@@ -0,0 +1,430 @@
+﻿module;
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <Siv3D.hpp>
+
+export module tomolatoon.asset.pack;
+import tomolatoon.asset.id;
+
+export namespace tomolatoon
+{
+	/// @brief アセットパックの中のデータの圧縮方式
+	enum class AssetPackCompression : uint32
+	{
+		None,
+
+		Zstd,
+	};
+
+	/// @brief アセットパックの先頭に置くヘッダ
+	struct AssetPackHeader
+	{
+		/// @brief "TAPK"
+		static constexpr uint32 Magic = 0x4B50'4154;
+
+		static constexpr uint32 Version = 1;
+
+		uint32 magic = Magic;
+
+		uint32 version = Version;
+
+		uint64 entryCount = 0;
+	};
+
+	/// @brief アセットパックの索引の 1 要素
+	struct AssetPackIndexEntry
+	{
+		/// @brief AssetID の値
+		uint64 id = 0;
+
+		/// @brief ファイルの先頭からデータまでのバイト数
+		uint64 offset = 0;
+
+		/// @brief パックの中でのデータの大きさ（圧縮されていれば圧縮後の大きさ）
+		uint64 size = 0;
+
+		/// @brief 展開した後のデータの大きさ
+		uint64 originalSize = 0;
+
+		AssetPackCompression compression = AssetPackCompression::None;
+
+		uint32 reserved = 0;
+	};
+
+	/// @brief アセットパックの 1 つのアセットを読む IReader
+	/// @details
+	/// 圧縮されていなければ、マップしたメモリを直接読む（コピーしない）。圧縮されていれば、展開したものを持つ。
+	/// 読み終わるまでマップを保つので、AssetPack より長く使ってもよい。
+	struct AssetPackReader final : public IReader
+	{
+		AssetPackReader(std::shared_ptr<const void> mapping, const Byte* data, size_t size)
+			: m_mapping(std::move(mapping))
+			, m_data(data)
+			, m_size(size)
+			, m_reader(data, size) {}
+
+		explicit AssetPackReader(Blob decompressed)
+			: m_decompressed(std::move(decompressed))
+			, m_data(m_decompressed.data())
+			, m_size(m_decompressed.size())
+			, m_reader(m_data, m_size) {}
+
+		// 展開したデータを指しているので、コピーはしない
+		AssetPackReader(const AssetPackReader&) = delete;
+
+		AssetPackReader(AssetPackReader&&) = default;
+
+		AssetPackReader& operator=(const AssetPackReader&) = delete;
+
+		AssetPackReader& operator=(AssetPackReader&&) = default;
+
+		/// @brief データの先頭。IReader を介さずにメモリとして読む場合に使う
+		const Byte* data() const noexcept {
+			return m_data;
+		}
+
+		using IReader::lookahead;
+		using IReader::read;
+
+		bool supportsLookahead() const noexcept override {
+			return true;
+		}
+
+		bool isOpen() const noexcept override {
+			return m_reader.isOpen();
+		}
+
+		int64 size() const override {
+			return m_reader.size();
+		}
+
+		int64 getPos() const override {
+			return m_reader.getPos();
+		}
+
+		bool setPos(int64 pos) override {
+			return m_reader.setPos(pos);
+		}
+
+		int64 skip(int64 offset) override {
+			return m_reader.skip(offset);
+		}
+
+		int64 read(void* dst, int64 size) override {
+			return m_reader.read(dst, size);
+		}
+
+		int64 read(void* dst, int64 pos, int64 size) override {
+			return m_reader.read(dst, pos, size);
+		}
+
+		int64 lookahead(void* dst, int64 size) const override {
+			return m_reader.lookahead(dst, size);
+		}
+
+		int64 lookahead(void* dst, int64 pos, int64 size) const override {
+			return m_reader.lookahead(dst, pos, size);
+		}
+
+	private:
+
+		std::shared_ptr<const void> m_mapping;
+
+		Blob m_decompressed;
+
+		const Byte* m_data = nullptr;
+
+		size_t m_size = 0;
+
+		MemoryViewReader m_reader;
+	};
+
+	/// @brief 多数のアセットを 1 つにまとめたファイル（アセットパック）をメモリにマップして読む
+	/// @details
+	/// アセットパックは AssetPackWriter で作る。形式は次の通り（リトルエンディアン）。
+	///
+	/// - AssetPackHeader
+	/// - AssetPackIndexEntry × entryCount（id の昇順）
+	/// - 各アセットのデータ（16 バイト境界に揃える）
+	///
+	/// 開く時はファイルをマップするだけで、索引もマップしたメモリを二分探索する。
+	/// したがって、起動時の I/O はマップ 1 回と、実際に読んだデータのページフォールトだけになる。
+	///
+	/// @code
+	/// const AssetPack pack{U"assets.pack"};
+	///
+	/// TextureAsset::Register(U"logo.png"_aid, AssetPackSource{pack, U"logo.png"_aid}, TextureDesc::Mipped);
+	/// @endcode
+	struct AssetPack
+	{
+		AssetPack() = default;
+
+		/// @brief path のアセットパックを開く。開けなければ isOpen が false になる
+		explicit AssetPack(FilePathView path) {
+			auto data = std::make_shared<Data>();
+
+			if (not data->file.open(path))
+			{ return; }
+
+			data->memory = data->file.mapAll();
+
+			if (data->memory.data == nullptr || data->memory.size < sizeof(AssetPackHeader))
+			{ return; }
+
+			const auto& header = *reinterpret_cast<const AssetPackHeader*>(data->memory.data);
+
+			if (header.magic != AssetPackHeader::Magic || header.version != AssetPackHeader::Version
+			    || header.entryCount > ((data->memory.size - sizeof(AssetPackHeader)) / sizeof(AssetPackIndexEntry)))
+			{ return; }
+
+			data->index = {
+				reinterpret_cast<const AssetPackIndexEntry*>(data->memory.data + sizeof(AssetPackHeader)),
+				static_cast<size_t>(header.entryCount),
+			};
+
+			m_data = std::move(data);
+		}
+
+		bool isOpen() const noexcept {
+			return static_cast<bool>(m_data);
+		}
+
+		explicit operator bool() const noexcept {
+			return isOpen();
+		}
+
+		/// @brief アセットの数
+		size_t size() const noexcept {
+			return (m_data ? m_data->index.size() : 0);
+		}
+
+		bool contains(AssetID id) const {
+			return find(id).has_value();
+		}
+
+		/// @brief id のアセットの索引
+		Optional<AssetPackIndexEntry> find(AssetID id) const {
+			if (not m_data)
+			{ return none; }
+
+			const auto& index = m_data->index;
+
+			const auto it = std::ranges::lower_bound(index, id.value(), {}, &AssetPackIndexEntry::id);
+
+			if (it == index.end() || it->id != id.value())
+			{ return none; }
+
+			return *it;
+		}
+
+		/// @brief 全てのアセットの ID（昇順）
+		Array<AssetID> ids() const {
+			Array<AssetID> result(Arg::reserve = size());
+
+			if (m_data)
+			{
+				for (const auto& entry : m_data->index)
+				{ result.emplace_back(entry.id); }
+			}
+
+			return result;
+		}
+
+		/// @brief id のアセットを読む IReader を作る
+		/// @return 無いか、壊れていれば none
+		Optional<AssetPackReader> open(AssetID id) const {
+			const auto entry = find(id);
+
+			if (not entry)
+			{ return none; }
+
+			const size_t fileSize = m_data->memory.size;
+
+			if (entry->offset > fileSize || entry->size > (fileSize - entry->offset))
+			{ return none; }
+
+			const Byte*  data = (m_data->memory.data + entry->offset);
+			const size_t size = static_cast<size_t>(entry->size);
+
+			switch (entry->compression)
+			{
+			case AssetPackCompression::None:
+				// Data を共有して、読み終わるまでマップを保つ
+				return AssetPackReader{std::shared_ptr<const void>{m_data, data}, data, size};
+			case AssetPackCompression::Zstd:
+				if (Blob blob = Zstd::Decompress(data, size); blob.size() == entry->originalSize)
+				{ return AssetPackReader{std::move(blob)}; }
+				return none;
+			default:
+				return none;
+			}
+		}
+
+	private:
+
+		struct Data
+		{
+			MemoryMappedFileView file;
+
+			MemoryMappedFileView::MappedMemory memory;
+
+			// マップしたメモリの中の索引
+			std::span<const AssetPackIndexEntry> index;
+		};
+
+		std::shared_ptr<const Data> m_data;
+	};
+
+	/// @brief Asset::Register の引数にすると、構築する時にアセットパックの id のデータを読む AssetPackReader になる
+	struct AssetPackSource
+	{
+		AssetPack pack;
+
+		AssetID id;
+
+		/// @brief id のデータを読む AssetPackReader を作る。読めなければ例外を投げる
+		AssetPackReader open() const {
+			if (auto reader = pack.open(id))
+			{ return std::move(*reader); }
+
+			throw Error(U"[AssetPackSource]: Asset `{}` is not found in the pack"_fmt(id));
+		}
+	};
+
+	/// @brief アセットパックを作る
+	/// @details パッカー（samples/asset_packer）のように、ビルド時に実行することを想定している
+	struct AssetPackWriter
+	{
+		/// @brief data を id のアセットとして加える
+		/// @note 圧縮しても小さくならなければ、圧縮せずに入れる（読む時にコピーせずに済む）
+		void add(AssetID id, Blob data, AssetPackCompression compression = AssetPackCompression::None) {
+			const uint64 originalSize = data.size();
+
+			if (compression == AssetPackCompression::Zstd)
+			{
+				if (Blob compressed = Zstd::Compress(data.data(), data.size()); compressed.size() < data.size())
+				{ data = std::move(compressed); }
+				else
+				{ compression = AssetPackCompression::None; }
+			}
+
+			m_items.push_back(Item{
+				.id           = id,
+				.compression  = compression,
+				.originalSize = originalSize,
+				.data         = std::move(data),
+			});
+		}
+
+		/// @brief path のファイルの中身を id のアセットとして加える
+		/// @return ファイルを読めなければ false
+		bool addFile(AssetID id, FilePathView path, AssetPackCompression compression = AssetPackCompression::None) {
+			Blob blob;
+
+			if (not blob.createFromFile(path))
+			{ return false; }
+
+			add(id, std::move(blob), compression);
+
+			return true;
+		}
+
+		/// @brief 加えたアセットの数
+		size_t size() const noexcept {
+			return m_items.size();
+		}
+
+		/// @brief path に書き出す
+		/// @return 書き出せなければ false
+		/// @exception Error 同じ ID のアセットが 2 つ以上ある場合
+		bool save(FilePathView path) const {
+			Array<const Item*> items(Arg::reserve = m_items.size());
+
+			for (const auto& item : m_items)
+			{ items.push_back(&item); }
+
+			std::ranges::sort(items, {}, [](const Item* item) { return item->id.value(); });
+
+			const auto duplicated = std::ranges::adjacent_find(items, {}, [](const Item* item) { return item->id; });
+
+			if (duplicated != items.end())
+			{ throw Error(U"[AssetPackWriter]: Asset `{}` is added more than once"_fmt((*duplicated)->id)); }
+
+			Array<AssetPackIndexEntry> index(Arg::reserve = items.size());
+
+			uint64 offset = Align(sizeof(AssetPackHeader) + (sizeof(AssetPackIndexEntry) * items.size()));
+
+			for (const auto item : items)
+			{
+				index.push_back(AssetPackIndexEntry{
+					.id           = item->id.value(),
+					.offset       = offset,
+					.size         = item->data.size(),
+					.originalSize = item->originalSize,
+					.compression  = item->compression,
+					.reserved     = 0,
+				});
+
+				offset = Align(offset + item->data.size());
+			}
+
+			BinaryWriter writer{path};
+
+			if (not writer)
+			{ return false; }
+
+			const AssetPackHeader header{
+				.magic      = AssetPackHeader::Magic,
+				.version    = AssetPackHeader::Version,
+				.entryCount = items.size(),
+			};
+
+			// 全て書き込めたら true。書き込めなければ、そこでやめる
+			const auto write = [&](const void* data, uint64 size) {
+				return (writer.write(data, static_cast<int64>(size)) == static_cast<int64>(size));
+			};
+
+			if (not write(&header, sizeof(header))
+			    || not write(index.data(), (sizeof(AssetPackIndexEntry) * index.size())))
+			{ return false; }
+
+			uint64 written = (sizeof(header) + (sizeof(AssetPackIndexEntry) * index.size()));
+
+			for (size_t i = 0; i < items.size(); ++i)
+			{
+				static constexpr Byte Zeros[Alignment] = {};
+
+				// 次のデータの位置まで 0 で埋める。Align で揃えているので、Alignment 未満で済む
+				if (not write(Zeros, (index[i].offset - written))
+				    || not write(items[i]->data.data(), items[i]->data.size()))
+				{ return false; }
+
+				written = (index[i].offset + index[i].size);
+			}
+
+			return true;
+		}
+
+	private:
+
+		static constexpr uint64 Alignment = 16;
+
+		static constexpr uint64 Align(uint64 offset) noexcept {
+			return ((offset + (Alignment - 1)) & ~(Alignment - 1));
+		}
+
+		struct Item
+		{
+			AssetID id;
+
+			AssetPackCompression compression = AssetPackCompression::None;
+
+			uint64 originalSize = 0;
+
+			Blob data;
+		};
+
+		Array<Item> m_items;
+	};
+} // namespace tomolatoon